@@ -0,0 +1,24 @@
+#pragma once
+
+// Everything at once; each component can also be included on its own from generator_searcher/
+
+#include "generator_searcher/allocation_profile.hpp"
+#include "generator_searcher/logger.hpp"
+#include "generator_searcher/inline_string.hpp"
+#include "generator_searcher/message.hpp"
+#include "generator_searcher/scheduler.hpp"
+#include "generator_searcher/container.hpp"
+#include "generator_searcher/pooled_container.hpp"
+#include "generator_searcher/mpmc_container.hpp"
+#include "generator_searcher/lane_container.hpp"
+#include "generator_searcher/clock.hpp"
+#include "generator_searcher/generator.hpp"
+#include "generator_searcher/deduplicator.hpp"
+#include "generator_searcher/key_index.hpp"
+#include "generator_searcher/fuzzy.hpp"
+#include "generator_searcher/count_min_sketch.hpp"
+#include "generator_searcher/searcher.hpp"
+#include "generator_searcher/trace_reader.hpp"
+#include "generator_searcher/replay.hpp"
+#include "generator_searcher/pipeline.hpp"
+#include "generator_searcher/bench.hpp"
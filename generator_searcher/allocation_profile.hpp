@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <utility>
+
+/**
+ * @brief Parts of the program allocations are attributed to, see AllocationScope
+ */
+enum class AllocationStage : uint8_t
+{
+    other,
+    generator, // building messages
+    container, // queue storage
+    search,    // Searcher lookups, indexes and storage
+    expiry,    // removal of expired messages
+    logging,   // log lines and their formatting
+    count
+};
+
+#ifdef ALLOCATION_PROFILE
+constexpr bool allocation_profile = true;
+#else
+constexpr bool allocation_profile = false;
+#endif
+
+/**
+ * @brief Counters of the operator new replacement compiled in with -DALLOCATION_PROFILE. Every allocation
+ * is attributed to the stage of the allocating thread; the totals per processed message are printed at exit
+ */
+struct AllocationProfile
+{
+    static inline thread_local AllocationStage stage = AllocationStage::other;
+    static inline std::array<std::atomic<uint64_t>, static_cast<size_t>(AllocationStage::count)> allocations{}, bytes{};
+    static inline std::atomic<uint64_t> messages{0}; // processed by a Searcher
+
+    static void record(size_t size) noexcept
+    {
+        allocations[static_cast<size_t>(stage)].fetch_add(1, std::memory_order_relaxed);
+        bytes[static_cast<size_t>(stage)].fetch_add(size, std::memory_order_relaxed);
+    }
+
+    static void report()
+    {
+        static const char *names[] = {"other", "generator", "container", "search", "expiry", "logging"};
+        uint64_t total = messages;
+        std::cout << "[Allocations]: " << total << " messages processed" << std::endl;
+        for (size_t i = 0; i < allocations.size(); ++i)
+        {
+            std::cout << "[Allocations]: " << std::setw(9) << names[i] << ": " << std::setw(10) << allocations[i] << " allocations, "
+                      << std::setw(12) << bytes[i] << " bytes";
+            if (total)
+                std::cout << std::fixed << std::setprecision(2) << " (" << static_cast<double>(allocations[i]) / total << " allocations, "
+                          << static_cast<double>(bytes[i]) / total << " bytes per message)";
+            std::cout << std::endl;
+        }
+    }
+};
+
+/**
+ * @brief Attributes the allocations of the current thread to a stage until the end of the scope.
+ * Compiles to nothing without -DALLOCATION_PROFILE. Must not be held across a co_await
+ */
+class AllocationScope
+{
+    AllocationStage _previous = AllocationStage::other;
+
+public:
+    explicit AllocationScope(AllocationStage stage)
+    {
+        if constexpr (allocation_profile)
+            _previous = std::exchange(AllocationProfile::stage, stage);
+    }
+
+    AllocationScope(const AllocationScope &) = delete;
+
+    ~AllocationScope()
+    {
+        if constexpr (allocation_profile)
+            AllocationProfile::stage = _previous;
+    }
+};
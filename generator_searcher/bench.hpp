@@ -0,0 +1,317 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "message.hpp"
+#include "searcher.hpp"
+#include "generator.hpp"
+#include "clock.hpp"
+
+/**
+ * @brief Contention benchmark of a container: `threads` producers and as many consumers move
+ * `per_thread` messages each through the queue
+ * 
+ * @return messages per second
+ */
+template <class Queue>
+double benchmark_queue(Queue &queue, unsigned int threads, size_t per_thread)
+{
+    std::vector<Message> messages;
+    messages.reserve(per_thread);
+    for (size_t i = 0; i < per_thread; ++i)
+        messages.push_back(Generator::make_message(i, i % 1000));
+
+    std::atomic<unsigned int> ready{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&]
+            {
+                ready.fetch_add(1);
+                while (!go.load(std::memory_order_acquire))
+                    std::this_thread::yield();
+                for (const Message &message : messages)
+                    queue.push(Message(message));
+            });
+        workers.emplace_back([&]
+            {
+                ready.fetch_add(1);
+                while (!go.load(std::memory_order_acquire))
+                    std::this_thread::yield();
+                for (size_t i = 0; i < per_thread; ++i)
+                    queue.pop();
+            });
+    }
+    while (ready.load() < 2 * threads)
+        std::this_thread::yield();
+
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto &worker : workers)
+        worker.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return threads * per_thread / elapsed.count();
+}
+
+/**
+ * @brief Message with the time it was pushed, carried through the queue by LatencyProbe
+ */
+struct StampedMessage
+{
+    Message message;
+    std::chrono::steady_clock::time_point time;
+};
+
+/**
+ * @brief Benchmark adapter in front of a queue of StampedMessage: stamps messages on push and records,
+ * for each one, the time until its consumer is done with it (queueing plus processing)
+ * 
+ * @tparam Queue container of StampedMessage
+ */
+template <class Queue>
+class LatencyProbe
+{
+    Queue _queue;
+    std::vector<uint64_t> _samples; // nanoseconds, each index written once
+    std::atomic<size_t> _count{0};
+    std::atomic<bool> _recording{false};
+
+    void record(std::chrono::steady_clock::time_point time)
+    {
+        if (!_recording.load(std::memory_order_relaxed))
+            return;
+        size_t index = _count.fetch_add(1, std::memory_order_relaxed);
+        if (index < _samples.size())
+            _samples[index] = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - time).count();
+    }
+
+public:
+    /**
+     * @brief Popped message, its latency is recorded when the receipt is destroyed
+     */
+    class Receipt
+    {
+        using Item = decltype(std::declval<Queue &>().pop());
+
+        LatencyProbe &_probe;
+        Item _item;
+
+        StampedMessage &stamped()
+        {
+            if constexpr (std::is_same_v<Item, StampedMessage>)
+                return _item;
+            else
+                return *_item; // leased slot
+        }
+
+    public:
+        Receipt(LatencyProbe &probe, Item &&item) : _probe(probe), _item(std::move(item)) {}
+
+        Receipt(const Receipt &) = delete;
+
+        ~Receipt()
+        {
+            _probe.record(stamped().time);
+        }
+
+        Message &operator*()
+        {
+            return stamped().message;
+        }
+    };
+
+    template <class... Args>
+    explicit LatencyProbe(size_t max_samples, Args &&...queue_args) : _queue(std::forward<Args>(queue_args)...), _samples(max_samples) {}
+
+    void push(Message &&message)
+    {
+        _queue.push(StampedMessage{std::move(message), std::chrono::steady_clock::now()});
+    }
+
+    Receipt pop()
+    {
+        return Receipt(*this, _queue.pop());
+    }
+
+    bool empty()
+    {
+        return _queue.empty();
+    }
+
+    /**
+     * @brief Starts recording: messages consumed before, e.g. while warming up, are not counted
+     */
+    void start()
+    {
+        _recording = true;
+    }
+
+    /**
+     * @brief Freezes count() and the samples, messages consumed afterwards are not recorded
+     */
+    void stop()
+    {
+        _recording = false;
+    }
+
+    size_t count() const
+    {
+        return _count;
+    }
+
+    /**
+     * @brief Latency quantile over the recorded samples, call once no consumer records any more
+     */
+    std::chrono::nanoseconds quantile(double q)
+    {
+        size_t n = std::min(_count.load(), _samples.size());
+        if (!n)
+            return {};
+        auto nth = _samples.begin() + std::min(n - 1, static_cast<size_t>(q * n));
+        std::nth_element(_samples.begin(), nth, _samples.begin() + n);
+        return std::chrono::nanoseconds(*nth);
+    }
+};
+
+/**
+ * @brief Message source for benchmarks. A match_ratio share of the messages repeats the phone of one
+ * of the producer's last `keys` messages that has not been repeated yet, so it finds a stored
+ * candidate while that one is within the window. Every other phone and login is fresh: ids are
+ * producer, producer + producers, ... so producers never share one (phones repeat after 10^7 ids).
+ * A repeat consumes the unmatched message it repeats, so match ratios above 0.5 saturate at half
+ */
+inline std::function<Message()> bench_source(uint32_t keys, double match_ratio, unsigned int producer, unsigned int producers)
+{
+    struct Unmatched
+    {
+        uint32_t phone;
+        uint64_t sent; // message number of the producer
+    };
+    return [keys, match_ratio, producers, rng = std::mt19937_64(producer + 1), pool = std::vector<Unmatched>(), sent = uint64_t(0),
+            next = uint32_t(producer)]() mutable
+    {
+        ++sent;
+        uint32_t id = next;
+        next += producers;
+        if (std::uniform_real_distribution<double>(0, 1)(rng) < match_ratio)
+        {
+            // Too old entries are dropped as they are drawn
+            while (!pool.empty())
+            {
+                size_t i = rng() % pool.size();
+                Unmatched unmatched = pool[i];
+                pool[i] = pool.back();
+                pool.pop_back();
+                if (sent - unmatched.sent <= keys)
+                    return Generator::make_message(unmatched.phone, id);
+            }
+        }
+        if (match_ratio > 0)
+        {
+            pool.push_back({id, sent});
+            if (pool.size() > 2 * size_t(keys))
+                std::erase_if(pool, [&](const Unmatched &unmatched)
+                              { return sent - unmatched.sent > keys; });
+        }
+        return Generator::make_message(id, id);
+    };
+}
+
+/**
+ * @brief One cell of the benchmark matrix
+ */
+struct BenchCell
+{
+    std::chrono::milliseconds window;
+    uint32_t keys;
+    double match_ratio;
+    unsigned int producers;
+    unsigned int consumers;
+    std::string container; // "mutex", "mpmc" or "pooled"
+};
+
+struct BenchResult
+{
+    double throughput = 0; // messages processed per second
+    std::chrono::nanoseconds p50{}, p99{};
+    double matched = 0; // share of processed messages that found a match
+};
+
+/**
+ * @brief Runs real Generator threads and Searcher threads over a LatencyProbe: a warm-up of one window
+ * fills the storage up to its steady state, then throughput, latency and matches are measured over
+ * duration. Every producer offers one message per interval (none between when it is zero)
+ */
+template <class Queue, class... Args>
+BenchResult run_bench_cell(const BenchCell &cell, std::chrono::milliseconds duration, Clock::duration interval, Args &&...queue_args)
+{
+    LatencyProbe<Queue> probe(size_t(1) << 22, std::forward<Args>(queue_args)...);
+    SearcherOptions searcher_options;
+    searcher_options.window = cell.window;
+    searcher_options.log_matches = false;
+
+    BenchResult result;
+    std::list<Generator> generators;
+    for (unsigned int i = 0; i < cell.producers; ++i)
+    {
+        GeneratorOptions generator_options;
+        generator_options.interval = interval;
+        generator_options.log_messages = false;
+        generator_options.source = bench_source(cell.keys, cell.match_ratio, i, cell.producers);
+        generators.emplace_back(probe, generator_options);
+    }
+    std::list<Searcher> searchers;
+    for (unsigned int i = 0; i < cell.consumers; ++i)
+        searchers.emplace_back(probe, searcher_options);
+
+    auto matches = [&searchers]()
+    {
+        uint64_t result = 0;
+        for (auto &searcher : searchers)
+            result += searcher.matches();
+        return result;
+    };
+    std::this_thread::sleep_for(cell.window);
+    uint64_t warm_up_matches = matches();
+    auto start = std::chrono::steady_clock::now();
+    probe.start();
+    std::this_thread::sleep_for(duration);
+    probe.stop();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    size_t processed = probe.count();
+    uint64_t matched = matches() - warm_up_matches;
+
+    // Consumers stop first, then one thread keeps draining so producers blocked on a full queue can stop
+    searchers.clear();
+    std::atomic<bool> draining{true};
+    std::thread drain([&]()
+        {
+            while (draining)
+            {
+                if (!probe.empty())
+                    probe.pop();
+            }
+        });
+    generators.clear();
+    draining = false;
+    drain.join();
+
+    result.throughput = processed / elapsed.count();
+    result.p50 = probe.quantile(0.5);
+    result.p99 = probe.quantile(0.99);
+    result.matched = processed ? static_cast<double>(matched) / processed : 0;
+    return result;
+}
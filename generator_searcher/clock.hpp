@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+/**
+ * @brief Time source of Generator and Searcher, injectable so expiry can be replayed without real waiting
+ */
+class Clock
+{
+public:
+    using time_point = std::chrono::steady_clock::time_point;
+    using duration = std::chrono::steady_clock::duration;
+
+    virtual ~Clock() = default;
+    virtual time_point now() const = 0;
+    virtual void sleep_for(duration duration) = 0;
+    virtual void sleep_until(time_point time) = 0;
+};
+
+class SteadyClock : public Clock
+{
+public:
+    time_point now() const override
+    {
+        return std::chrono::steady_clock::now();
+    }
+
+    void sleep_for(duration duration) override
+    {
+        std::this_thread::sleep_for(duration);
+    }
+
+    void sleep_until(time_point time) override
+    {
+        std::this_thread::sleep_until(time);
+    }
+
+    static SteadyClock &instance()
+    {
+        static SteadyClock clock;
+        return clock;
+    }
+};
+
+/**
+ * @brief Clock moved only explicitly, e.g. by trace timestamps. Sleeping advances it instantly
+ */
+class SimulatedClock : public Clock
+{
+    std::atomic<duration::rep> _now{0};
+
+public:
+    time_point now() const override
+    {
+        return time_point(duration(_now.load()));
+    }
+
+    void sleep_for(duration duration) override
+    {
+        advance(duration);
+    }
+
+    void sleep_until(time_point time) override
+    {
+        // Never moves backwards: another thread may already have advanced past time
+        auto target = time.time_since_epoch().count();
+        auto now = _now.load();
+        while (now < target && !_now.compare_exchange_weak(now, target))
+            ;
+    }
+
+    void set(time_point time)
+    {
+        _now = time.time_since_epoch().count();
+    }
+
+    void advance(duration duration)
+    {
+        _now += duration.count();
+    }
+};
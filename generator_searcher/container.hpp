@@ -0,0 +1,287 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <span>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "scheduler.hpp"
+#include "allocation_profile.hpp"
+
+/**
+ * @brief How a Container tells consumers it has elements
+ */
+enum class ContainerNotification
+{
+    condition_variable, // blocking pop() only
+    eventfd             // also an eventfd, readable while the container is non-empty, see Container::event_fd()
+};
+
+/**
+ * @brief Thread-safe shared container, implemented as queue  
+ * 
+ * @tparam MessageType 
+ */
+template <class MessageType>
+class Container
+{
+private:
+    // Coroutine suspended in pop_async(), resumed on its Scheduler once an element is handed over
+    struct Waiter
+    {
+        Scheduler &scheduler;
+        std::coroutine_handle<> handle;
+        std::optional<MessageType> result;
+    };
+
+    std::queue<MessageType> _container;
+    std::deque<Waiter *> _waiters;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::condition_variable _room_cv; // producers in wait_for_room()
+    size_t _room_waiters = 0;
+    size_t _room_limit = 0; // largest size a producer in wait_for_room() is waiting for
+    int _event_fd = -1;
+
+    // The eventfd is only written on the empty to non-empty transition and read back on the
+    // reverse one, both under the mutex: it is readable exactly while elements are queued
+    void signal_ready()
+    {
+        if (_event_fd >= 0)
+        {
+            uint64_t one = 1;
+            while (write(_event_fd, &one, sizeof(one)) < 0 && errno == EINTR)
+                ;
+        }
+    }
+
+    void clear_ready()
+    {
+        if (_event_fd >= 0 && _container.empty())
+        {
+            uint64_t count;
+            while (read(_event_fd, &count, sizeof(count)) < 0 && errno == EINTR)
+                ;
+        }
+    }
+
+    MessageType take()
+    {
+        MessageType result = std::move(_container.front());
+        _container.pop();
+        clear_ready();
+        if (_room_waiters && _container.size() <= _room_limit)
+            _room_cv.notify_all();
+        return result;
+    }
+
+public:
+    explicit Container(ContainerNotification notification = ContainerNotification::condition_variable)
+    {
+        if (notification == ContainerNotification::eventfd)
+        {
+            _event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (_event_fd < 0)
+                throw std::system_error(errno, std::generic_category(), "eventfd");
+        }
+    }
+
+    ~Container()
+    {
+        if (_event_fd >= 0)
+            close(_event_fd);
+    }
+
+    Container(const Container &) = delete;
+    Container &operator=(const Container &) = delete;
+
+    /**
+     * @brief With ContainerNotification::eventfd, a non-blocking eventfd that polls readable while the
+     * container holds elements, for epoll or io_uring loops; -1 otherwise. Consumers wait on it and
+     * take elements with try_pop() until it returns std::nullopt. Owned by the container
+     */
+    int event_fd() const
+    {
+        return _event_fd;
+    }
+
+    void push(MessageType &&message)
+    {
+        AllocationScope stage(AllocationStage::container);
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (!_waiters.empty())
+        {
+            // Hand the element directly to a suspended coroutine
+            Waiter *waiter = _waiters.front();
+            _waiters.pop_front();
+            waiter->result.emplace(std::move(message));
+            lock.unlock();
+            waiter->scheduler.schedule(waiter->handle);
+            return;
+        }
+        _container.push(message);
+        if (_container.size() == 1)
+            signal_ready();
+        _cv.notify_one();
+    }
+
+    /**
+     * @brief Moves all of messages in under a single lock, consumers are woken once
+     */
+    void push_batch(std::span<MessageType> messages)
+    {
+        AllocationScope stage(AllocationStage::container);
+        std::unique_lock<std::mutex> lock(_mutex);
+        std::deque<Waiter *> waiters;
+        size_t i = 0;
+        for (; i < messages.size() && !_waiters.empty(); ++i)
+        {
+            // Hand elements directly to suspended coroutines first
+            Waiter *waiter = _waiters.front();
+            _waiters.pop_front();
+            waiter->result.emplace(std::move(messages[i]));
+            waiters.push_back(waiter);
+        }
+        bool was_empty = _container.empty();
+        for (; i < messages.size(); ++i)
+            _container.push(std::move(messages[i]));
+        if (was_empty && !_container.empty())
+            signal_ready();
+        lock.unlock();
+        for (Waiter *waiter : waiters)
+            waiter->scheduler.schedule(waiter->handle);
+        _cv.notify_all();
+    }
+
+    /**
+     * @brief Blocks the thread until element is received from the container
+     * 
+     * @return MessageType
+     */
+    MessageType pop()
+    {
+        AllocationScope stage(AllocationStage::container);
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [this]()
+                 { return !_container.empty(); });
+        return take();
+    }
+
+    /**
+     * @brief Takes an element if there is one, never blocks
+     * 
+     * @return std::optional<MessageType>
+     */
+    std::optional<MessageType> try_pop()
+    {
+        AllocationScope stage(AllocationStage::container);
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_container.empty())
+            return std::nullopt;
+        return take();
+    }
+
+    /**
+     * @brief Blocks the thread until an element is available, then moves up to max elements to out
+     */
+    void pop_batch(std::vector<MessageType> &out, size_t max)
+    {
+        AllocationScope stage(AllocationStage::container);
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [this]()
+                 { return !_container.empty(); });
+        while (!_container.empty() && out.size() < max)
+            out.push_back(take());
+    }
+
+    /**
+     * @brief Awaitable version of pop(): suspends the coroutine instead of blocking the thread.
+     * Resumes with std::nullopt if cancel is set and notify_waiters() is called
+     * 
+     * @return std::optional<MessageType>
+     */
+    auto pop_async(Scheduler &scheduler, const std::atomic<bool> &cancel)
+    {
+        struct Awaiter
+        {
+            Container &container;
+            const std::atomic<bool> &cancel;
+            Waiter waiter;
+
+            bool await_ready() const noexcept { return false; }
+            bool await_suspend(std::coroutine_handle<> handle)
+            {
+                std::lock_guard<std::mutex> lock(container._mutex);
+                if (!container._container.empty())
+                {
+                    waiter.result.emplace(container.take());
+                    return false;
+                }
+                if (cancel)
+                    return false;
+                waiter.handle = handle;
+                container._waiters.push_back(&waiter);
+                return true;
+            }
+            std::optional<MessageType> await_resume() { return std::move(waiter.result); }
+        };
+        return Awaiter{*this, cancel, Waiter{scheduler, {}, std::nullopt}};
+    }
+
+    /**
+     * @brief Resumes every coroutine suspended in pop_async() with std::nullopt,
+     * so the ones whose cancel flag is set can finish
+     */
+    void notify_waiters()
+    {
+        std::deque<Waiter *> waiters;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            waiters.swap(_waiters);
+        }
+        for (Waiter *waiter : waiters)
+            waiter->scheduler.schedule(waiter->handle);
+    }
+
+    /**
+     * @brief Blocks the thread while more than max elements are queued, for producers that pace
+     * themselves to the consumers
+     */
+    void wait_for_room(size_t max)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        if (_container.size() <= max)
+            return;
+        ++_room_waiters;
+        _room_limit = std::max(_room_limit, max);
+        _room_cv.wait(lock, [this, max]()
+                      { return _container.size() <= max; });
+        if (--_room_waiters == 0)
+            _room_limit = 0;
+    }
+
+    bool empty()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _container.empty();
+    }
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _container.size();
+    }
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+
+/**
+ * @brief Count-min sketch of per-key counts. Supports decrements, so it can follow a sliding window,
+ * and never underestimates. Counters are atomic: other threads may query while one thread updates
+ */
+class CountMinSketch
+{
+    const size_t _width; // power of two
+    const size_t _depth;
+    std::unique_ptr<std::atomic<uint32_t>[]> _counters;
+
+    size_t cell(uint64_t hash, size_t row) const
+    {
+        uint64_t h = hash + (row + 1) * 0x9e3779b97f4a7c15ull;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        return row * _width + (h & (_width - 1));
+    }
+
+public:
+    CountMinSketch(size_t width = 4096, size_t depth = 4)
+        : _width(std::bit_ceil(width)), _depth(depth), _counters(new std::atomic<uint32_t>[_width * _depth]())
+    {
+    }
+
+    void add(uint64_t hash, int32_t delta)
+    {
+        for (size_t row = 0; row < _depth; ++row)
+            _counters[cell(hash, row)].fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    uint32_t estimate(uint64_t hash) const
+    {
+        uint32_t result = UINT32_MAX;
+        for (size_t row = 0; row < _depth; ++row)
+            result = std::min(result, _counters[cell(hash, row)].load(std::memory_order_relaxed));
+        return result;
+    }
+};
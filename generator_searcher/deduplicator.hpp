@@ -0,0 +1,61 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+
+#include "message.hpp"
+#include "clock.hpp"
+
+/**
+ * @brief Time-bounded set of (phone, login) fingerprints. A message identical to one kept
+ * less than interval ago is reported as a duplicate
+ */
+class Deduplicator
+{
+    using timestamp = std::chrono::steady_clock::time_point;
+
+    const std::chrono::milliseconds _interval;
+    std::unordered_map<uint64_t, timestamp> _seen;      // fingerprint -> time it was kept
+    std::deque<std::pair<timestamp, uint64_t>> _order; // kept fingerprints, oldest in front
+    uint64_t _dropped = 0;
+
+    static uint64_t fingerprint(const Message &msg)
+    {
+        uint64_t phone = std::hash<Message::Field>{}(msg.phone_number);
+        uint64_t login = std::hash<Message::Field>{}(msg.login);
+        return phone ^ (login + 0x9e3779b97f4a7c15ull + (phone << 6) + (phone >> 2));
+    }
+
+public:
+    explicit Deduplicator(std::chrono::milliseconds interval) : _interval(interval) {}
+
+    bool is_duplicate(const Message &msg, timestamp time)
+    {
+        while (!_order.empty() && time - _order.front().first >= _interval)
+        {
+            auto it = _seen.find(_order.front().second);
+            if (it != _seen.end() && it->second == _order.front().first)
+                _seen.erase(it);
+            _order.pop_front();
+        }
+
+        uint64_t key = fingerprint(msg);
+        auto [it, inserted] = _seen.try_emplace(key, time);
+        if (!inserted)
+        {
+            ++_dropped;
+            return true;
+        }
+        _order.emplace_back(time, key);
+        return false;
+    }
+
+    uint64_t dropped() const
+    {
+        return _dropped;
+    }
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Every distinct string obtained by deleting 1..distance characters from str
+ */
+inline std::vector<std::string> deletions(std::string_view str, unsigned int distance)
+{
+    // Each level is appended to result and expanded from there, duplicates are removed once at the end:
+    // cheap for the distances of 1 and 2 the Searcher uses, exponential beyond
+    size_t count = 0, per_level = 1;
+    for (size_t level = 1, size = str.size(); level <= distance && size; ++level, --size)
+        count += per_level *= size;
+    std::vector<std::string> result;
+    result.reserve(count); // every level fits: the views expanded below stay valid
+    auto remove_each = [&result](std::string_view variant)
+    {
+        for (size_t i = 0; i < variant.size(); ++i)
+            result.emplace_back(variant.substr(0, i)).append(variant.substr(i + 1));
+    };
+    if (distance)
+        remove_each(str);
+    for (size_t d = 1, begin = 0; d < distance; ++d)
+    {
+        size_t end = result.size();
+        for (size_t i = begin; i < end; ++i)
+            remove_each(result[i]);
+        begin = end;
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+/**
+ * @brief Levenshtein distance between a and b, or limit + 1 if it exceeds limit
+ */
+inline unsigned int edit_distance(std::string_view a, std::string_view b, unsigned int limit)
+{
+    if ((a.size() > b.size() ? a.size() - b.size() : b.size() - a.size()) > limit)
+        return limit + 1;
+    unsigned int inline_row[64]; // logins fit, longer strings take the heap
+    std::vector<unsigned int> heap_row;
+    unsigned int *row = inline_row;
+    if (b.size() + 1 > std::size(inline_row))
+    {
+        heap_row.resize(b.size() + 1);
+        row = heap_row.data();
+    }
+    for (size_t j = 0; j <= b.size(); ++j)
+        row[j] = j;
+    for (size_t i = 1; i <= a.size(); ++i)
+    {
+        unsigned int diagonal = row[0];
+        row[0] = i;
+        unsigned int row_min = row[0];
+        for (size_t j = 1; j <= b.size(); ++j)
+        {
+            unsigned int above = row[j];
+            row[j] = std::min({row[j] + 1, row[j - 1] + 1, diagonal + (a[i - 1] != b[j - 1])});
+            diagonal = above;
+            row_min = std::min(row_min, row[j]);
+        }
+        if (row_min > limit)
+            return limit + 1;
+    }
+    return std::min(row[b.size()], limit + 1);
+}
+
+/**
+ * @brief Digits of a phone number without "+", separators and placeholders
+ */
+inline std::string phone_digits(std::string_view phone_number)
+{
+    std::string result;
+    for (char c : phone_number)
+    {
+        if (c >= '0' && c <= '9')
+            result += c;
+    }
+    return result;
+}
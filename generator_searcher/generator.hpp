@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include "message.hpp"
+#include "clock.hpp"
+#include "container.hpp"
+#include "scheduler.hpp"
+#include "logger.hpp"
+#include "allocation_profile.hpp"
+
+/**
+ * @brief The demo messages: phones "+7-915-XXX-XX-00" to "-06" in turn, random logins "login_a" to "login_j"
+ */
+class DemoSource
+{
+    uint64_t _sequence = 0;
+    std::minstd_rand _random;
+
+public:
+    explicit DemoSource(uint64_t seed) : _random(seed) {}
+
+    Message operator()()
+    {
+        char number[] = "+7-915-XXX-XX-0?";
+        number[sizeof(number) - 2] = '0' + _sequence++ % 7;
+        char login[] = "login_?";
+        login[sizeof(login) - 2] = char('a' + _random() % 10);
+        return Message(std::string_view(number, sizeof(number) - 1), std::string_view(login, sizeof(login) - 1));
+    }
+};
+
+struct GeneratorOptions
+{
+    Clock::duration interval = std::chrono::milliseconds(1000); // between the starts of two messages, so the rate holds however long a push takes
+    bool log_messages = true;                                   // debug log line per generated message
+    Clock *clock = nullptr;                                     // time source for the pause, the steady clock when null
+    size_t lane = 0;                                            // lane pushed to when the container has lanes
+    std::function<Message()> source{};                          // builds the messages, a DemoSource when empty
+    uint64_t seed = 0;                                          // seed of the DemoSource, 0 picks one from the clock
+    Logger *logger = nullptr;                                   // where log lines go, nothing is logged when null
+};
+
+class Generator
+{
+    std::thread _thread;
+    std::atomic<bool> _terminate_flag;
+    Completion _finished; // set when the coroutine mode loop has returned
+    const GeneratorOptions _options;
+
+    std::function<Message()> _source;
+
+    void log(const Message &msg) const
+    {
+        if (!_options.log_messages || !_options.logger)
+            return;
+        AllocationScope logging(AllocationStage::logging);
+        (*_options.logger)("[Debug] [Generator]: Adding (" + msg.phone_number + ", " + msg.login + ")");
+    }
+
+    static uint64_t seed(const GeneratorOptions &options)
+    {
+        return options.seed ? options.seed : std::chrono::steady_clock::now().time_since_epoch().count();
+    }
+
+public:
+    /**
+     * @brief Builds the message with phone "+7-915-DDD-DD-DD" (last 7 digits of phone) and login "login_<login>".
+     * Keys are formatted on the stack, nothing is allocated
+     */
+    static Message make_message(uint32_t phone, uint32_t login)
+    {
+        static constexpr char pairs[] =
+            "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+            "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+            "8081828384858687888990919293949596979899";
+
+        char number[] = "+7-915-000-00-00";
+        phone %= 10000000;
+        std::memcpy(number + 14, pairs + 2 * (phone % 100), 2);
+        phone /= 100;
+        std::memcpy(number + 11, pairs + 2 * (phone % 100), 2);
+        phone /= 100;
+        number[7] = '0' + phone / 100;
+        std::memcpy(number + 8, pairs + 2 * (phone % 100), 2);
+
+        char login_buffer[32] = "login_";
+        char *end = std::to_chars(login_buffer + 6, login_buffer + sizeof(login_buffer), login).ptr;
+        return Message(std::string_view(number, sizeof(number) - 1), std::string_view(login_buffer, end - login_buffer));
+    }
+
+private:
+    /**
+     * @brief When the next message is due: one interval after the previous one, on an absolute schedule
+     * so the time spent generating and pushing doesn't lower the rate. A producer more than max_lag
+     * behind (blocked on a full queue) restarts the schedule instead of catching up in a burst
+     */
+    static Clock::time_point next_due(Clock::time_point due, Clock::duration interval, Clock::time_point now)
+    {
+        static constexpr Clock::duration max_lag = std::chrono::seconds(1);
+        due += interval;
+        return due + max_lag < now ? now : due;
+    }
+
+    Task run(Container<Message> &container, Scheduler &scheduler)
+    {
+        auto due = std::chrono::steady_clock::now();
+        while (!_terminate_flag)
+        {
+            {
+                AllocationScope stage(AllocationStage::generator);
+                Message msg = _source();
+                log(msg);
+                container.push(std::move(msg));
+            }
+            due = next_due(due, _options.interval, std::chrono::steady_clock::now());
+            co_await scheduler.sleep_until(due);
+        }
+        _finished.set(); // last access to *this
+    }
+
+public:
+    template <class Queue>
+        requires requires(Queue &queue, Message &&msg) { queue.push(std::move(msg)); }
+    Generator(Queue &container, const GeneratorOptions &options = {})
+        : _options(options), _source(options.source ? options.source : DemoSource(seed(options)))
+    {
+        _terminate_flag = false;
+        _thread = std::thread([this](Queue &container, Clock &clock)
+            {
+                auto due = clock.now();
+                while (!_terminate_flag)
+                {
+                    AllocationScope stage(AllocationStage::generator);
+                    Message msg = _source();
+                    log(msg);
+                    if constexpr (requires { container.push(std::move(msg), _options.lane); })
+                        container.push(std::move(msg), _options.lane);
+                    else
+                        container.push(std::move(msg));
+                    due = next_due(due, _options.interval, clock.now());
+                    clock.sleep_until(due);
+                }
+            },
+            std::ref(container), std::ref(_options.clock ? *_options.clock : SteadyClock::instance()));
+    };
+
+    /**
+     * @brief Coroutine mode: the generation loop runs as a coroutine on the scheduler's pool
+     * instead of owning a thread
+     */
+    Generator(Container<Message> &container, Scheduler &scheduler, const GeneratorOptions &options = {})
+        : _options(options), _source(options.source ? options.source : DemoSource(seed(options)))
+    {
+        _terminate_flag = false;
+        scheduler.spawn(run(container, scheduler));
+    }
+
+    ~Generator()
+    {
+        _terminate_flag = true;
+        if (_thread.joinable())
+            _thread.join();
+        else
+            _finished.wait();
+    }
+};
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Fixed-size string keeping up to Capacity - 1 characters inline, longer values fall back
+ * to the heap. Typical logins and phone numbers are stored without any allocation
+ * 
+ * @tparam Capacity total size in bytes: the characters, or a heap pointer and size, then the length byte
+ */
+template <size_t Capacity>
+class InlineString
+{
+    static_assert(Capacity > sizeof(char *) + sizeof(size_t) && Capacity <= 255); // an inline length of 255 would read as heap_tag
+    static constexpr uint8_t heap_tag = 0xFF;
+
+    struct Heap
+    {
+        char *data;
+        size_t size;
+    };
+
+    // Inline characters or a Heap (copied in and out, the bytes are unaligned), the last byte is
+    // the inline length or heap_tag
+    char _bytes[Capacity];
+
+    uint8_t tag() const
+    {
+        return static_cast<uint8_t>(_bytes[Capacity - 1]);
+    }
+
+    void set_tag(uint8_t tag)
+    {
+        _bytes[Capacity - 1] = static_cast<char>(tag);
+    }
+
+    bool on_heap() const
+    {
+        return tag() == heap_tag;
+    }
+
+    Heap heap() const
+    {
+        Heap heap;
+        std::memcpy(&heap, _bytes, sizeof(heap));
+        return heap;
+    }
+
+    void assign(std::string_view str)
+    {
+        if (str.size() < Capacity)
+        {
+            std::memcpy(_bytes, str.data(), str.size());
+            set_tag(static_cast<uint8_t>(str.size()));
+        }
+        else
+        {
+            Heap heap{new char[str.size()], str.size()};
+            std::memcpy(heap.data, str.data(), str.size());
+            std::memcpy(_bytes, &heap, sizeof(heap));
+            set_tag(heap_tag);
+        }
+    }
+
+    void release()
+    {
+        if (on_heap())
+            delete[] heap().data;
+    }
+
+public:
+    /** @brief Longest value stored without allocating */
+    static constexpr size_t inline_capacity = Capacity - 1;
+
+    InlineString(std::string_view str = {})
+    {
+        assign(str);
+    }
+
+    InlineString(const std::string &str) : InlineString(std::string_view(str)) {}
+
+    InlineString(const char *str) : InlineString(std::string_view(str)) {}
+
+    InlineString(const InlineString &other)
+    {
+        assign(other.view());
+    }
+
+    InlineString(InlineString &&other) noexcept
+    {
+        std::memcpy(_bytes, other._bytes, Capacity);
+        other.set_tag(0);
+    }
+
+    InlineString &operator=(const InlineString &other)
+    {
+        if (this != &other)
+            *this = InlineString(other); // allocate before releasing, a throwing new leaves *this intact
+        return *this;
+    }
+
+    InlineString &operator=(InlineString &&other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            std::memcpy(_bytes, other._bytes, Capacity);
+            other.set_tag(0);
+        }
+        return *this;
+    }
+
+    ~InlineString()
+    {
+        release();
+    }
+
+    const char *data() const
+    {
+        return on_heap() ? heap().data : _bytes;
+    }
+
+    size_t size() const
+    {
+        return on_heap() ? heap().size : tag();
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    const char *begin() const
+    {
+        return data();
+    }
+
+    const char *end() const
+    {
+        return data() + size();
+    }
+
+    std::string_view view() const
+    {
+        return {data(), size()};
+    }
+
+    operator std::string_view() const
+    {
+        return view();
+    }
+
+    std::string str() const
+    {
+        return std::string(view());
+    }
+
+    friend bool operator==(const InlineString &a, const InlineString &b)
+    {
+        return a.view() == b.view();
+    }
+
+    friend std::string operator+(std::string lhs, const InlineString &rhs)
+    {
+        return lhs.append(rhs.view());
+    }
+
+    friend std::string operator+(const char *lhs, const InlineString &rhs)
+    {
+        return std::string(lhs).append(rhs.view());
+    }
+
+    friend std::string operator+(const InlineString &lhs, const char *rhs)
+    {
+        return lhs.str() + rhs;
+    }
+
+    friend std::ostream &operator<<(std::ostream &stream, const InlineString &str)
+    {
+        return stream << str.view();
+    }
+};
+
+template <size_t Capacity>
+struct std::hash<InlineString<Capacity>>
+{
+    size_t operator()(const InlineString<Capacity> &str) const
+    {
+        return std::hash<std::string_view>{}(str.view());
+    }
+};
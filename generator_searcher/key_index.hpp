@@ -0,0 +1,294 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Hash index from a key to the values stored under it, oldest first.
+ * insert() returns a handle erasing the value in O(1). Open addressing with linear probing over
+ * (hash, node) slots: a batch can prefetch its slots, then its nodes, without waiting on either
+ * 
+ * @tparam Value 
+ */
+template <class Value>
+class KeyIndex
+{
+public:
+    using Bucket = std::list<Value>;
+    using Handle = typename Bucket::iterator;
+
+private:
+    struct Node
+    {
+        std::string key;
+        Bucket bucket;
+    };
+
+    struct Slot
+    {
+        size_t hash = 0;
+        std::unique_ptr<Node> node; // empty slot when null
+    };
+
+    std::vector<Slot> _slots; // power of two, at most half full
+    size_t _size = 0;
+    std::vector<std::unique_ptr<Node>> _free; // emptied nodes, reused with their key capacity
+
+    size_t mask() const
+    {
+        return _slots.size() - 1;
+    }
+
+    static size_t npos()
+    {
+        return static_cast<size_t>(-1);
+    }
+
+    size_t find_slot(std::string_view key, size_t hash) const
+    {
+        if (_slots.empty())
+            return npos();
+        for (size_t i = hash & mask();; i = (i + 1) & mask())
+        {
+            const Slot &slot = _slots[i];
+            if (!slot.node)
+                return npos();
+            if (slot.hash == hash && slot.node->key == key)
+                return i;
+        }
+    }
+
+    void grow()
+    {
+        std::vector<Slot> slots(std::max<size_t>(_slots.size() * 2, 16));
+        std::swap(slots, _slots);
+        for (Slot &slot : slots)
+        {
+            if (!slot.node)
+                continue;
+            size_t i = slot.hash & mask();
+            while (_slots[i].node)
+                i = (i + 1) & mask();
+            _slots[i] = std::move(slot);
+        }
+    }
+
+    /**
+     * @brief Empties slot i, shifting back the entries of its probe run that can move closer to their home
+     */
+    void remove_slot(size_t i)
+    {
+        _free.push_back(std::move(_slots[i].node));
+        --_size;
+        for (size_t hole = i, j = (i + 1) & mask(); _slots[j].node; j = (j + 1) & mask())
+        {
+            size_t home = _slots[j].hash & mask();
+            if (((j - home) & mask()) >= ((j - hole) & mask()))
+            {
+                _slots[hole] = std::move(_slots[j]);
+                hole = j;
+            }
+        }
+    }
+
+public:
+    static size_t hash(std::string_view key)
+    {
+        return std::hash<std::string_view>{}(key);
+    }
+
+    /**
+     * @brief The overloads taking a hash expect hash(key), computed once by the caller
+     */
+    Handle insert(std::string_view key, size_t hash, const Value &value)
+    {
+        size_t i = find_slot(key, hash);
+        if (i == npos())
+        {
+            if ((_size + 1) * 2 > _slots.size())
+                grow();
+            for (i = hash & mask(); _slots[i].node; i = (i + 1) & mask())
+                ;
+            if (_free.empty())
+            {
+                _slots[i].node = std::make_unique<Node>();
+            }
+            else
+            {
+                _slots[i].node = std::move(_free.back());
+                _free.pop_back();
+            }
+            _slots[i].node->key.assign(key);
+            _slots[i].hash = hash;
+            ++_size;
+        }
+        Bucket &bucket = _slots[i].node->bucket;
+        return bucket.insert(bucket.end(), value);
+    }
+
+    Handle insert(std::string_view key, const Value &value)
+    {
+        return insert(key, hash(key), value);
+    }
+
+    void erase(std::string_view key, size_t hash, Handle handle)
+    {
+        size_t i = find_slot(key, hash);
+        Bucket &bucket = _slots[i].node->bucket;
+        bucket.erase(handle);
+        if (bucket.empty())
+            remove_slot(i);
+    }
+
+    void erase(std::string_view key, Handle handle)
+    {
+        erase(key, hash(key), handle);
+    }
+
+    const Bucket *find(std::string_view key, size_t hash) const
+    {
+        size_t i = find_slot(key, hash);
+        return i != npos() ? &_slots[i].node->bucket : nullptr;
+    }
+
+    const Bucket *find(std::string_view key) const
+    {
+        return find(key, hash(key));
+    }
+
+    /**
+     * @brief First stage of a batch prefetch: starts loading the home slot of the key, touching nothing
+     */
+    void prefetch_slot(size_t hash) const
+    {
+        if (!_slots.empty())
+            __builtin_prefetch(&_slots[hash & mask()]);
+    }
+
+    /**
+     * @brief Second stage, once the slot has arrived: starts loading the node it points to, the key
+     * and the head of its bucket
+     */
+    void prefetch_node(size_t hash) const
+    {
+        if (_slots.empty())
+            return;
+        if (const Node *node = _slots[hash & mask()].node.get())
+            __builtin_prefetch(node);
+    }
+
+    /**
+     * @brief Third stage, once the node has arrived: starts loading the oldest value of the key.
+     * Returns the node's bucket when the home slot holds the key, nullptr otherwise
+     */
+    const Bucket *prefetch_bucket(std::string_view key, size_t hash) const
+    {
+        if (_slots.empty())
+            return nullptr;
+        const Slot &slot = _slots[hash & mask()];
+        if (!slot.node || slot.hash != hash || slot.node->key != key)
+            return nullptr;
+        __builtin_prefetch(&slot.node->bucket.front());
+        return &slot.node->bucket;
+    }
+};
+
+/**
+ * @brief Trie over decimal digit strings, values are stored in the node their key ends in.
+ * Lookups cost O(key length) however many values are stored; emptied branches are recycled
+ * 
+ * @tparam Value 
+ */
+template <class Value>
+class DigitTrie
+{
+public:
+    using Bucket = std::list<Value>;
+    using Handle = typename Bucket::iterator;
+
+private:
+    struct Node
+    {
+        std::array<uint32_t, 10> children{}; // 0 means no child, the root is never a child
+        uint32_t parent = 0;
+        uint8_t digit = 0;
+        uint8_t children_count = 0;
+        Bucket bucket;
+    };
+
+    std::vector<Node> _nodes{1};
+    std::vector<uint32_t> _free;
+
+    uint32_t walk(std::string_view key) const
+    {
+        uint32_t node = 0;
+        for (char c : key)
+        {
+            node = _nodes[node].children[c - '0'];
+            if (!node)
+                return 0;
+        }
+        return node;
+    }
+
+public:
+    /**
+     * @brief key must be a non-empty string of digits
+     */
+    Handle insert(std::string_view key, const Value &value)
+    {
+        uint32_t node = 0;
+        for (char c : key)
+        {
+            uint8_t digit = c - '0';
+            uint32_t child = _nodes[node].children[digit];
+            if (!child)
+            {
+                if (_free.empty())
+                {
+                    child = _nodes.size();
+                    _nodes.emplace_back();
+                }
+                else
+                {
+                    child = _free.back();
+                    _free.pop_back();
+                }
+                _nodes[child].parent = node;
+                _nodes[child].digit = digit;
+                _nodes[node].children[digit] = child;
+                ++_nodes[node].children_count;
+            }
+            node = child;
+        }
+        auto &bucket = _nodes[node].bucket;
+        return bucket.insert(bucket.end(), value);
+    }
+
+    void erase(std::string_view key, Handle handle)
+    {
+        uint32_t node = walk(key);
+        _nodes[node].bucket.erase(handle);
+        while (node != 0 && _nodes[node].bucket.empty() && _nodes[node].children_count == 0)
+        {
+            uint32_t parent = _nodes[node].parent;
+            _nodes[parent].children[_nodes[node].digit] = 0;
+            --_nodes[parent].children_count;
+            _free.push_back(node);
+            node = parent;
+        }
+    }
+
+    const Bucket *find(std::string_view key) const
+    {
+        uint32_t node = walk(key);
+        return node && !_nodes[node].bucket.empty() ? &_nodes[node].bucket : nullptr;
+    }
+};
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "allocation_profile.hpp"
+
+/**
+ * @brief How LaneContainer::pop() chooses between non-empty lanes
+ */
+enum class LanePolicy
+{
+    strict,  // always the lowest-numbered non-empty lane
+    weighted // round-robin, lane i serves up to weights[i] messages per turn
+};
+
+/**
+ * @brief Thread-safe container with a FIFO queue per lane. Latency-critical sources push to a
+ * high priority lane (lane 0 is the highest) so bulk traffic in other lanes doesn't queue ahead of them
+ * 
+ * @tparam MessageType 
+ */
+template <class MessageType>
+class LaneContainer
+{
+    std::vector<std::queue<MessageType>> _lanes;
+    std::vector<unsigned int> _weights;
+    std::vector<unsigned int> _credits; // messages the lane may still serve in its current turn
+    const LanePolicy _policy;
+    size_t _current = 0; // lane whose turn it is, weighted policy
+    size_t _count = 0;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+
+    // Called with the mutex held and at least one message queued
+    size_t next_lane()
+    {
+        if (_policy == LanePolicy::strict)
+        {
+            size_t lane = 0;
+            while (_lanes[lane].empty())
+                ++lane;
+            return lane;
+        }
+        while (_lanes[_current].empty() || _credits[_current] == 0)
+        {
+            _credits[_current] = _weights[_current];
+            _current = (_current + 1) % _lanes.size();
+        }
+        --_credits[_current];
+        return _current;
+    }
+
+public:
+    /**
+     * @param weights one entry per lane; only relative values matter, and only with LanePolicy::weighted
+     */
+    explicit LaneContainer(std::vector<unsigned int> weights, LanePolicy policy = LanePolicy::strict) : _lanes(std::max<size_t>(weights.size(), 1)), _weights(std::move(weights)), _policy(policy)
+    {
+        _weights.resize(_lanes.size(), 1);
+        for (unsigned int &weight : _weights)
+            weight = std::max(weight, 1u);
+        _credits = _weights;
+    }
+
+    size_t lanes() const
+    {
+        return _lanes.size();
+    }
+
+    /**
+     * @brief Pushes to the given lane, out of range lanes go to the lowest priority one
+     */
+    void push(MessageType &&message, size_t lane = 0)
+    {
+        AllocationScope stage(AllocationStage::container);
+        std::lock_guard<std::mutex> lock(_mutex);
+        _lanes[std::min(lane, _lanes.size() - 1)].push(std::move(message));
+        ++_count;
+        _cv.notify_one();
+    }
+
+    /**
+     * @brief Blocks the thread until element is received from the container
+     * 
+     * @return MessageType
+     */
+    MessageType pop()
+    {
+        AllocationScope stage(AllocationStage::container);
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [this]()
+                 { return _count != 0; });
+        std::queue<MessageType> &lane = _lanes[next_lane()];
+        MessageType result = std::move(lane.front());
+        lane.pop();
+        --_count;
+        return result;
+    }
+
+    bool empty()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _count == 0;
+    }
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <iostream>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+#include "allocation_profile.hpp"
+
+/**
+ * @brief Thread-safe sink of log lines. Components log through the Logger given in their options
+ * and stay silent without one
+ */
+class Logger
+{
+    std::ostream &_out;
+    std::mutex _mutex;
+
+public:
+    explicit Logger(std::ostream &out = std::cout) : _out(out) {}
+
+    void operator()(const std::string &line)
+    {
+        AllocationScope stage(AllocationStage::logging);
+        std::lock_guard<std::mutex> lock(_mutex);
+        _out << line << std::endl;
+    }
+};
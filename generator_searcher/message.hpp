@@ -0,0 +1,45 @@
+#pragma once
+
+#include <chrono>
+#include <sstream>
+#include <string_view>
+
+#include "inline_string.hpp"
+#include "logger.hpp"
+
+struct Message
+{
+    using Field = InlineString<24>;
+
+    const Field phone_number;
+    const Field login;
+    const std::chrono::milliseconds ttl; // lifespan in the Searcher storage, 0 means the Searcher's window
+
+    Message(std::string_view _phone_number, std::string_view _login, std::chrono::milliseconds _ttl = std::chrono::milliseconds(0))
+        : phone_number(_phone_number), login(_login), ttl(_ttl){};
+
+    bool IsValid()
+    {
+        return !phone_number.empty() || !login.empty();
+    }
+};
+
+/**
+ * @brief Result of a successful search
+ */
+struct Match
+{
+    Message incoming; // newly arrived message
+    Message stored;   // message found in the Searcher's internal storage
+    double score;
+};
+
+inline void log_match(Logger &log, const Match &match)
+{
+    AllocationScope stage(AllocationStage::logging);
+    std::ostringstream score;
+    score << match.score;
+    log("[Searcher]: Found (with score: " + score.str() + ")\n" +
+        "\tFrom shared storage: (" + match.incoming.phone_number + ", " + match.incoming.login + ")\n" +
+        "\tFrom internal storage: (" + match.stored.phone_number + ", " + match.stored.login + ")\n");
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <utility>
+
+/**
+ * @brief Lock-free bounded multi-producer/multi-consumer container (Vyukov's array queue): every cell
+ * carries a sequence number telling whether it is ready to be written or read at a given position.
+ * push() and pop() yield for a few rounds and then sleep on C++20 atomic waits when full or empty
+ * 
+ * @tparam MessageType 
+ */
+template <class MessageType>
+class MpmcContainer
+{
+    struct alignas(64) Cell
+    {
+        std::atomic<size_t> sequence;
+        std::optional<MessageType> value;
+    };
+
+    std::unique_ptr<Cell[]> _cells;
+    const size_t _mask;
+    alignas(64) std::atomic<size_t> _enqueue_pos{0};
+    alignas(64) std::atomic<size_t> _dequeue_pos{0};
+    alignas(64) std::atomic<uint32_t> _pushed{0}; // wait/notify counters for blocked consumers and producers
+    alignas(64) std::atomic<uint32_t> _popped{0};
+
+    static constexpr int spins = 16;
+
+public:
+    explicit MpmcContainer(size_t capacity = 1024) : _cells(new Cell[std::bit_ceil(std::max<size_t>(capacity, 2))]), _mask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1)
+    {
+        for (size_t i = 0; i <= _mask; ++i)
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    bool try_push(MessageType &&message)
+    {
+        size_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true)
+        {
+            cell = &_cells[pos & _mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false; // full
+            }
+            else
+            {
+                pos = _enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value.emplace(std::move(message));
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        _pushed.fetch_add(1, std::memory_order_release);
+        _pushed.notify_one();
+        return true;
+    }
+
+    std::optional<MessageType> try_pop()
+    {
+        size_t pos = _dequeue_pos.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true)
+        {
+            cell = &_cells[pos & _mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return std::nullopt; // empty
+            }
+            else
+            {
+                pos = _dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        std::optional<MessageType> result(std::move(cell->value));
+        cell->value.reset();
+        cell->sequence.store(pos + _mask + 1, std::memory_order_release);
+        _popped.fetch_add(1, std::memory_order_release);
+        _popped.notify_one();
+        return result;
+    }
+
+    /**
+     * @brief Blocks the thread while the container is full
+     */
+    void push(MessageType &&message)
+    {
+        for (int i = 0; !try_push(std::move(message)); ++i)
+        {
+            if (i < spins)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            uint32_t popped = _popped.load(std::memory_order_acquire);
+            if (try_push(std::move(message)))
+                return;
+            _popped.wait(popped);
+        }
+    }
+
+    /**
+     * @brief Blocks the thread until element is received from the container
+     * 
+     * @return MessageType
+     */
+    MessageType pop()
+    {
+        for (int i = 0;; ++i)
+        {
+            if (auto result = try_pop())
+                return std::move(*result);
+            if (i < spins)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            uint32_t pushed = _pushed.load(std::memory_order_acquire);
+            if (auto result = try_pop())
+                return std::move(*result);
+            _pushed.wait(pushed);
+        }
+    }
+
+    bool empty()
+    {
+        return _dequeue_pos.load(std::memory_order_relaxed) >= _enqueue_pos.load(std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,499 @@
+#pragma once
+
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "message.hpp"
+#include "logger.hpp"
+
+/**
+ * @brief Bounded lock-free single-producer/single-consumer ring, connects two pipeline workers
+ * without any mutex handoff. Values are swapped in and out rather than moved: the producer gets back
+ * what the consumer left in the slot, so batch buffers circulate instead of being reallocated
+ * 
+ * @tparam T 
+ */
+template <class T>
+class SpscRing
+{
+    std::vector<T> _slots;
+    const size_t _mask;
+    alignas(64) std::atomic<size_t> _head{0}; // next slot to read, written by the consumer only
+    alignas(64) std::atomic<size_t> _tail{0}; // next slot to write, written by the producer only
+    alignas(64) std::atomic<uint32_t> _popped{0}; // wait/notify counter for a blocked producer
+    alignas(64) std::atomic<bool> _closed{false};
+
+    static constexpr int spins = 16;
+
+    static size_t round_up(size_t capacity)
+    {
+        size_t result = 1;
+        while (result < capacity)
+            result <<= 1;
+        return result;
+    }
+
+public:
+    explicit SpscRing(size_t capacity) : _slots(round_up(capacity)), _mask(_slots.size() - 1) {}
+
+    /**
+     * @brief Swaps value into a free slot; value receives what the consumer left there
+     */
+    bool try_push(T &value)
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head.load(std::memory_order_acquire) == _slots.size())
+            return false;
+        std::swap(_slots[tail & _mask], value);
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Blocks the producer while the ring is full
+     */
+    void push(T &value)
+    {
+        for (int i = 0; !try_push(value); ++i)
+        {
+            if (i < spins)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            uint32_t popped = _popped.load(std::memory_order_acquire);
+            if (try_push(value))
+                return;
+            _popped.wait(popped);
+        }
+    }
+
+    /**
+     * @brief Swaps the oldest value out; the slot gets the previous content of value back
+     */
+    bool try_pop(T &value)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire))
+            return false;
+        std::swap(_slots[head & _mask], value);
+        _head.store(head + 1, std::memory_order_release);
+        _popped.fetch_add(1, std::memory_order_release);
+        _popped.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Called by the producer after its last push
+     */
+    void close()
+    {
+        _closed.store(true, std::memory_order_release);
+    }
+
+    bool closed() const
+    {
+        return _closed.load(std::memory_order_acquire);
+    }
+};
+
+struct StageOptions
+{
+    unsigned int threads = 1;
+    size_t batch = 64;     // items per batch handed to the next stage
+    size_t capacity = 256; // batches buffered per ring
+};
+
+struct StageMetrics
+{
+    std::atomic<uint64_t> items_in{0};
+    std::atomic<uint64_t> items_out{0};
+    std::atomic<uint64_t> batches_in{0};
+    std::atomic<uint64_t> busy_ns{0};
+};
+
+/**
+ * @brief Connection between two stages: one SPSC ring per (producer worker, consumer worker) pair
+ * 
+ * @tparam T 
+ */
+template <class T>
+struct Edge
+{
+    std::vector<std::vector<std::unique_ptr<SpscRing<std::vector<T>>>>> rings; // [producer][consumer]
+    // [consumer], bumped by producers after each push and close: an idle consumer waits on it
+    std::vector<std::unique_ptr<std::atomic<uint32_t>>> pushed;
+    std::function<size_t(const T &)> partition; // consumer selection, round-robin when empty
+
+    void notify(size_t consumer)
+    {
+        pushed[consumer]->fetch_add(1, std::memory_order_release);
+        pushed[consumer]->notify_one();
+    }
+};
+
+/**
+ * @brief Output side of a pipeline worker. Collects emitted items into per-consumer batches
+ * 
+ * @tparam T 
+ */
+template <class T>
+class Emitter
+{
+    Edge<T> *_edge;
+    const unsigned int _worker;
+    const size_t _batch;
+    StageMetrics &_metrics;
+    std::vector<std::vector<T>> _pending;
+    size_t _next = 0;
+
+    void flush(size_t consumer)
+    {
+        _edge->rings[_worker][consumer]->push(_pending[consumer]); // blocks while the consumer is behind
+        _pending[consumer].clear(); // a batch the consumer is done with, its capacity is reused
+        if (_pending[consumer].capacity() < _batch)
+            _pending[consumer].reserve(_batch); // a slot that had not circulated yet
+        _edge->notify(consumer);
+    }
+
+public:
+    Emitter(Edge<T> *edge, unsigned int worker, size_t batch, StageMetrics &metrics)
+        : _edge(edge), _worker(worker), _batch(batch), _metrics(metrics)
+    {
+        if (_edge)
+            _pending.resize(_edge->rings[_worker].size());
+        for (auto &pending : _pending)
+            pending.reserve(_batch);
+    }
+
+    void emit(T &&item)
+    {
+        ++_metrics.items_out;
+        if (_pending.empty())
+            return; // last stage without a sink
+        size_t consumer = (_edge->partition ? _edge->partition(item) : _next++) % _pending.size();
+        _pending[consumer].push_back(std::move(item));
+        if (_pending[consumer].size() >= _batch)
+            flush(consumer);
+    }
+
+    void flush()
+    {
+        for (size_t consumer = 0; consumer < _pending.size(); ++consumer)
+        {
+            if (!_pending[consumer].empty())
+                flush(consumer);
+        }
+    }
+
+    void close()
+    {
+        flush();
+        if (!_edge)
+            return;
+        for (size_t consumer = 0; consumer < _pending.size(); ++consumer)
+        {
+            _edge->rings[_worker][consumer]->close();
+            _edge->notify(consumer);
+        }
+    }
+
+    unsigned int worker() const
+    {
+        return _worker;
+    }
+};
+
+template <class T>
+class PipelineStage;
+
+/**
+ * @brief Generalization of Generator -> Container -> Searcher: a chain of typed stages,
+ * each with its own worker threads and metrics, connected by SPSC rings carrying batches
+ */
+class Pipeline
+{
+    struct StageBase
+    {
+        std::string name;
+        StageOptions options;
+        StageMetrics metrics;
+
+        StageBase(std::string &&_name, const StageOptions &_options) : name(_name), options(_options) {}
+        virtual ~StageBase() = default;
+        virtual void work(unsigned int worker, const std::atomic<bool> &stop) = 0;
+    };
+
+    static constexpr int spins = 16;
+
+    /**
+     * @brief Consumes every input ring of the worker until all of them are closed and drained.
+     * When they all stay empty the worker sleeps until a producer pushes or closes
+     */
+    template <class In, class Fn>
+    static void drain(Edge<In> &input, unsigned int worker, StageMetrics &metrics, Fn &&on_item, std::function<void()> on_idle)
+    {
+        std::vector<In> batch;
+        std::atomic<uint32_t> &pushed = *input.pushed[worker];
+        for (int idle = 0;;)
+        {
+            uint32_t seen = pushed.load(std::memory_order_acquire); // before looking: a later push changes it
+            bool received = false;
+            bool all_closed = true;
+            for (auto &producer : input.rings)
+            {
+                auto &ring = *producer[worker];
+                bool closed = ring.closed(); // checked first: no push can follow a close
+                if (ring.try_pop(batch))
+                {
+                    received = true;
+                    auto start = std::chrono::steady_clock::now();
+                    for (auto &item : batch)
+                        on_item(std::move(item));
+                    metrics.busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+                    metrics.items_in += batch.size();
+                    ++metrics.batches_in;
+                }
+                else if (!closed)
+                {
+                    all_closed = false;
+                }
+            }
+            if (received)
+            {
+                idle = 0;
+                continue;
+            }
+            on_idle();
+            if (all_closed)
+                return;
+            if (idle++ < spins)
+                std::this_thread::yield();
+            else
+                pushed.wait(seen);
+        }
+    }
+
+    template <class Out>
+    struct SourceStage : StageBase
+    {
+        std::function<bool(Emitter<Out> &)> fn;
+        std::shared_ptr<Edge<Out>> output = std::make_shared<Edge<Out>>();
+
+        using StageBase::StageBase;
+
+        void work(unsigned int worker, const std::atomic<bool> &stop) override
+        {
+            Emitter<Out> out(output->rings.empty() ? nullptr : output.get(), worker, options.batch, metrics);
+            bool more = true;
+            while (more && !stop)
+            {
+                auto start = std::chrono::steady_clock::now();
+                more = fn(out);
+                out.flush();
+                metrics.busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            }
+            out.close();
+        }
+    };
+
+    template <class In, class Out>
+    struct TransformStage : StageBase
+    {
+        std::function<void(In &&, Emitter<Out> &)> fn;
+        std::shared_ptr<Edge<In>> input;
+        std::shared_ptr<Edge<Out>> output = std::make_shared<Edge<Out>>();
+
+        using StageBase::StageBase;
+
+        void work(unsigned int worker, const std::atomic<bool> &) override
+        {
+            Emitter<Out> out(output->rings.empty() ? nullptr : output.get(), worker, options.batch, metrics);
+            drain(*input, worker, metrics, [this, &out](In &&item)
+                  { fn(std::move(item), out); },
+                  [&out]()
+                  { out.flush(); });
+            out.close();
+        }
+    };
+
+    template <class In>
+    struct SinkStage : StageBase
+    {
+        std::function<void(In &&)> fn;
+        std::shared_ptr<Edge<In>> input;
+
+        using StageBase::StageBase;
+
+        void work(unsigned int worker, const std::atomic<bool> &) override
+        {
+            drain(*input, worker, metrics, fn, []() {});
+        }
+    };
+
+    template <class T>
+    static void connect(Edge<T> &edge, unsigned int producers, const StageOptions &consumer_options)
+    {
+        edge.rings.resize(producers);
+        for (auto &row : edge.rings)
+        {
+            for (unsigned int i = 0; i < consumer_options.threads; ++i)
+                row.push_back(std::make_unique<SpscRing<std::vector<T>>>(consumer_options.capacity));
+        }
+        for (unsigned int i = 0; i < consumer_options.threads; ++i)
+            edge.pushed.push_back(std::make_unique<std::atomic<uint32_t>>(0));
+    }
+
+    std::vector<std::unique_ptr<StageBase>> _stages;
+    std::vector<std::thread> _threads;
+    std::atomic<bool> _stop{false};
+
+    template <class T>
+    friend class PipelineStage;
+
+public:
+    ~Pipeline()
+    {
+        stop();
+    }
+
+    /**
+     * @brief First stage: fn is called repeatedly, emitting items, until it returns false or stop() is called
+     */
+    template <class Out>
+    PipelineStage<Out> source(std::string name, StageOptions options, std::function<bool(Emitter<Out> &)> fn);
+
+    void run()
+    {
+        for (auto &stage : _stages)
+        {
+            for (unsigned int worker = 0; worker < stage->options.threads; ++worker)
+                _threads.emplace_back([this, &stage, worker]()
+                                      { stage->work(worker, _stop); });
+        }
+    }
+
+    /**
+     * @brief Stops the sources and waits until everything already emitted has drained through the stages
+     */
+    void stop()
+    {
+        _stop = true;
+        for (auto &thread : _threads)
+            thread.join();
+        _threads.clear();
+    }
+
+    /**
+     * @brief Metrics of the stage called name, nullptr if there is none
+     */
+    const StageMetrics *metrics(const std::string &name) const
+    {
+        for (auto &stage : _stages)
+        {
+            if (stage->name == name)
+                return &stage->metrics;
+        }
+        return nullptr;
+    }
+
+    void report(Logger &log) const
+    {
+        for (auto &stage : _stages)
+        {
+            uint64_t batches = stage->metrics.batches_in;
+            log("[Pipeline]: Stage '" + stage->name + "' x" + std::to_string(stage->options.threads) +
+                ": in " + std::to_string(stage->metrics.items_in) +
+                ", out " + std::to_string(stage->metrics.items_out) +
+                ", batches " + std::to_string(batches) +
+                " (avg " + std::to_string(batches ? stage->metrics.items_in / batches : 0) + ")" +
+                ", busy " + std::to_string(stage->metrics.busy_ns / 1000000) + " ms");
+        }
+    }
+};
+
+/**
+ * @brief Builder handle for the output of the last added stage
+ * 
+ * @tparam T type of items emitted by that stage
+ */
+template <class T>
+class PipelineStage
+{
+    Pipeline &_pipeline;
+    std::shared_ptr<Edge<T>> _output;
+    unsigned int _producers;
+
+public:
+    PipelineStage(Pipeline &pipeline, std::shared_ptr<Edge<T>> output, unsigned int producers)
+        : _pipeline(pipeline), _output(std::move(output)), _producers(producers) {}
+
+    /**
+     * @brief Appends a stage calling fn for every item; fn may emit any number of results.
+     * partition selects the worker of the new stage for an item, for stages keeping per-key state
+     */
+    template <class Out>
+    PipelineStage<Out> then(std::string name, StageOptions options, std::function<void(T &&, Emitter<Out> &)> fn,
+                            std::function<size_t(const T &)> partition = {})
+    {
+        auto stage = std::make_unique<Pipeline::TransformStage<T, Out>>(std::move(name), options);
+        stage->fn = std::move(fn);
+        stage->input = _output;
+        _output->partition = std::move(partition);
+        Pipeline::connect(*_output, _producers, options);
+        PipelineStage<Out> next(_pipeline, stage->output, options.threads);
+        _pipeline._stages.push_back(std::move(stage));
+        return next;
+    }
+
+    void sink(std::string name, StageOptions options, std::function<void(T &&)> fn,
+              std::function<size_t(const T &)> partition = {})
+    {
+        auto stage = std::make_unique<Pipeline::SinkStage<T>>(std::move(name), options);
+        stage->fn = std::move(fn);
+        stage->input = _output;
+        _output->partition = std::move(partition);
+        Pipeline::connect(*_output, _producers, options);
+        _pipeline._stages.push_back(std::move(stage));
+    }
+};
+
+template <class Out>
+PipelineStage<Out> Pipeline::source(std::string name, StageOptions options, std::function<bool(Emitter<Out> &)> fn)
+{
+    auto stage = std::make_unique<SourceStage<Out>>(std::move(name), options);
+    stage->fn = std::move(fn);
+    PipelineStage<Out> next(*this, stage->output, options.threads);
+    _stages.push_back(std::move(stage));
+    return next;
+}
+
+/**
+ * @brief Canonical form of a message: login trimmed at both ends and lowercased, phone without separators
+ */
+inline Message normalize(const Message &msg)
+{
+    std::string phone, login;
+    for (char c : msg.phone_number)
+    {
+        if (c != '-' && c != ' ' && c != '(' && c != ')')
+            phone += c;
+    }
+    std::string_view trimmed = msg.login.view();
+    while (!trimmed.empty() && isspace(static_cast<unsigned char>(trimmed.front())))
+        trimmed.remove_prefix(1);
+    while (!trimmed.empty() && isspace(static_cast<unsigned char>(trimmed.back())))
+        trimmed.remove_suffix(1);
+    for (char c : trimmed)
+        login += static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    return Message(std::move(phone), std::move(login), msg.ttl);
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Thread-safe bounded container over a ring of preallocated slots. Producers construct elements
+ * in a free slot, consumers lease filled slots and give them back; no allocation in steady state
+ * 
+ * @tparam MessageType 
+ */
+template <class MessageType>
+class PooledContainer
+{
+    std::vector<std::optional<MessageType>> _slots;
+    std::vector<size_t> _free;  // stack of free slot indexes
+    std::vector<size_t> _ready; // ring of filled slot indexes, in push order
+    size_t _head = 0;
+    std::atomic<size_t> _count{0}; // filled slots
+    std::mutex _mutex;
+    std::condition_variable _not_empty, _not_full;
+
+    void release(size_t index)
+    {
+        _slots[index].reset();
+        std::lock_guard<std::mutex> lock(_mutex);
+        _free.push_back(index);
+        _not_full.notify_one();
+    }
+
+public:
+    /**
+     * @brief Filled slot handed to a consumer, returned to the pool when the lease is destroyed
+     */
+    class Lease
+    {
+        PooledContainer *_container;
+        size_t _index;
+
+    public:
+        Lease(PooledContainer &container, size_t index) : _container(&container), _index(index) {}
+
+        Lease(Lease &&other) noexcept : _container(std::exchange(other._container, nullptr)), _index(other._index) {}
+
+        Lease &operator=(Lease &&other) = delete;
+
+        ~Lease()
+        {
+            if (_container)
+                _container->release(_index);
+        }
+
+        MessageType &operator*() const
+        {
+            return *_container->_slots[_index];
+        }
+
+        MessageType *operator->() const
+        {
+            return &**this;
+        }
+    };
+
+    explicit PooledContainer(size_t capacity = 1024) : _slots(capacity), _ready(capacity)
+    {
+        _free.reserve(capacity);
+        for (size_t i = capacity; i > 0; --i)
+            _free.push_back(i - 1);
+    }
+
+    /**
+     * @brief Constructs an element in place in a free slot, blocks while all slots are in use
+     */
+    template <class... Args>
+    void emplace(Args &&...args)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _not_full.wait(lock, [this]()
+                       { return !_free.empty(); });
+        size_t index = _free.back();
+        _free.pop_back();
+        lock.unlock();
+
+        _slots[index].emplace(std::forward<Args>(args)...);
+
+        lock.lock();
+        _ready[(_head + _count) % _ready.size()] = index;
+        ++_count;
+        _not_empty.notify_one();
+    }
+
+    void push(MessageType &&message)
+    {
+        emplace(std::move(message));
+    }
+
+    /**
+     * @brief Blocks the thread until an element is received from the container
+     * 
+     * @return Lease on the slot holding it
+     */
+    Lease pop()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _not_empty.wait(lock, [this]()
+                        { return _count > 0; });
+        size_t index = _ready[_head];
+        _head = (_head + 1) % _ready.size();
+        --_count;
+        return Lease(*this, index);
+    }
+
+    bool empty()
+    {
+        return _count == 0;
+    }
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "searcher.hpp"
+#include "clock.hpp"
+#include "generator.hpp"
+#include "logger.hpp"
+#include "trace_reader.hpp"
+
+struct ReplayStats
+{
+    uint64_t messages = 0;
+    uint64_t matches = 0;
+    std::chrono::milliseconds span{0}; // simulated time covered by the trace
+};
+
+inline void replay_record(TraceRecord &&record, Searcher &searcher, SimulatedClock &clock, Logger *logger, ReplayStats &stats)
+{
+    clock.set(Clock::time_point(record.time));
+    ++stats.messages;
+    if (auto match = searcher.process(std::move(record.message)))
+    {
+        ++stats.matches;
+        if (logger)
+            log_match(*logger, *match);
+    }
+    stats.span = record.time;
+}
+
+/**
+ * @brief Feeds a trace of "<milliseconds> <phone_number> <login> [ttl milliseconds]" lines to an inline
+ * Searcher, moving the simulated clock to each record's timestamp first. The result depends on the trace only.
+ * Matches are logged when a logger is given
+ */
+inline ReplayStats replay(std::istream &trace, Searcher &searcher, SimulatedClock &clock, Logger *logger = nullptr)
+{
+    ReplayStats stats;
+    std::string line;
+    while (std::getline(trace, line))
+    {
+        if (auto record = parse_trace_record(line))
+            replay_record(std::move(*record), searcher, clock, logger, stats);
+    }
+    return stats;
+}
+
+/**
+ * @brief Same as replay() of a stream, the trace file being read in large chunks ahead of the Searcher
+ */
+inline ReplayStats replay(TraceReader &reader, Searcher &searcher, SimulatedClock &clock, Logger *logger = nullptr)
+{
+    ReplayStats stats;
+    std::vector<TraceRecord> records;
+    while (reader.read(records))
+    {
+        for (auto &record : records)
+            replay_record(std::move(record), searcher, clock, logger, stats);
+        records.clear();
+    }
+    return stats;
+}
+
+/**
+ * @brief Writes a trace of demo messages, one every interval
+ */
+inline void write_trace(std::ostream &trace, uint64_t messages, std::chrono::milliseconds interval, uint64_t seed)
+{
+    DemoSource source(seed);
+    for (uint64_t i = 0; i < messages; ++i)
+    {
+        Message msg = source();
+        trace << (interval * i).count() << ' ' << msg.phone_number << ' ' << msg.login << '\n';
+    }
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Fire-and-forget coroutine. Starts suspended and is resumed by a Scheduler,
+ * its frame is destroyed when the body returns
+ */
+struct Task
+{
+    struct promise_type
+    {
+        Task get_return_object() { return Task{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+/**
+ * @brief One-shot flag a coroutine sets as its last access to the object owning it, waited for by the
+ * object's destructor. The notify is done under the lock: wait() can't return, and the owner can't be
+ * destroyed, before set() is done with the flag
+ */
+class Completion
+{
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    bool _done = false;
+
+public:
+    void set()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _done = true;
+        _cv.notify_all();
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait(lock, [this]()
+                 { return _done; });
+    }
+};
+
+/**
+ * @brief Small fixed pool of threads resuming coroutines, plus one timer thread for sleeping ones.
+ * Lets hundreds of logical Generators/Searchers share a few OS threads
+ */
+class Scheduler
+{
+    using clock = std::chrono::steady_clock;
+
+    struct Sleeper
+    {
+        clock::time_point deadline;
+        std::coroutine_handle<> handle;
+
+        bool operator>(const Sleeper &other) const { return deadline > other.deadline; }
+    };
+
+    std::vector<std::thread> _workers;
+    std::thread _timer;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<std::coroutine_handle<>> _ready;
+    std::condition_variable _timer_cv;
+    std::priority_queue<Sleeper, std::vector<Sleeper>, std::greater<Sleeper>> _sleeping;
+    bool _stop = false;
+
+public:
+    explicit Scheduler(unsigned int threads = std::max(1u, std::thread::hardware_concurrency()))
+    {
+        for (unsigned int i = 0; i < threads; ++i)
+        {
+            _workers.emplace_back([this]()
+                {
+                    while (true)
+                    {
+                        std::unique_lock<std::mutex> lock(_mutex);
+                        _cv.wait(lock, [this]()
+                                 { return _stop || !_ready.empty(); });
+                        if (_ready.empty())
+                            return;
+                        auto handle = _ready.front();
+                        _ready.pop_front();
+                        lock.unlock();
+                        handle.resume();
+                    }
+                });
+        }
+        _timer = std::thread([this]()
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                while (!_stop)
+                {
+                    if (_sleeping.empty())
+                    {
+                        _timer_cv.wait(lock);
+                        continue;
+                    }
+                    _timer_cv.wait_until(lock, _sleeping.top().deadline);
+                    while (!_sleeping.empty() && _sleeping.top().deadline <= clock::now())
+                    {
+                        _ready.push_back(_sleeping.top().handle);
+                        _sleeping.pop();
+                        _cv.notify_one();
+                    }
+                }
+            });
+    }
+
+    ~Scheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _cv.notify_all();
+        _timer_cv.notify_all();
+        _timer.join();
+        for (auto &worker : _workers)
+            worker.join();
+        // Coroutines still sleeping were never finished by their owners
+        while (!_sleeping.empty())
+        {
+            _sleeping.top().handle.destroy();
+            _sleeping.pop();
+        }
+    }
+
+    void schedule(std::coroutine_handle<> handle)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _ready.push_back(handle);
+        _cv.notify_one();
+    }
+
+    void spawn(Task task)
+    {
+        schedule(task.handle);
+    }
+
+    /**
+     * @brief Awaitable suspending the coroutine until the deadline without blocking a pool thread
+     */
+    auto sleep_until(clock::time_point deadline)
+    {
+        struct Awaiter
+        {
+            Scheduler &scheduler;
+            clock::time_point deadline;
+
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                std::lock_guard<std::mutex> lock(scheduler._mutex);
+                scheduler._sleeping.push({deadline, handle});
+                scheduler._timer_cv.notify_one();
+            }
+            void await_resume() const noexcept {}
+        };
+        return Awaiter{*this, deadline};
+    }
+
+    /**
+     * @brief Awaitable suspending the coroutine for the given time without blocking a pool thread
+     */
+    auto sleep_for(clock::duration duration)
+    {
+        return sleep_until(clock::now() + duration);
+    }
+};
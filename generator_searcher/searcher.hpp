@@ -0,0 +1,888 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "message.hpp"
+#include "clock.hpp"
+#include "container.hpp"
+#include "scheduler.hpp"
+#include "logger.hpp"
+#include "allocation_profile.hpp"
+#include "deduplicator.hpp"
+#include "key_index.hpp"
+#include "fuzzy.hpp"
+#include "count_min_sketch.hpp"
+#include "inline_string.hpp"
+
+/**
+ * @brief What a fuzzy login lookup does with deletion keys shared by more than SearcherOptions::fanout_cap
+ * stored logins. Only these keys grow: an exact phone, login or pair key holds at most one live entry,
+ * as a second one would have matched it. Capped walks never evict anything from the storage
+ */
+enum class FanoutPolicy
+{
+    keep_newest,     // only the newest entries of the key are walked
+    first_candidate, // the walk stops at the key's first (oldest) candidate
+    spill            // entries beyond the cap are only walked when the first ones gave no candidate
+};
+
+/**
+ * @brief Called with every match of a threaded or coroutine Searcher, on its matching thread: the newly
+ * arrived message, the stored one it matched and the score. The messages are only valid during the call
+ */
+using MatchSink = std::function<void(const Message &incoming, const Message &stored, double score)>;
+
+/**
+ * @brief Called with the matches of a threaded or coroutine Searcher in groups of up to
+ * SearcherOptions::match_batch, and with the rest whenever the container runs empty
+ */
+using MatchBatchSink = std::function<void(std::span<const Match> matches)>;
+
+/**
+ * @brief Compile-time match sink of Searcher::process_batch(), called like a MatchSink
+ */
+template <class Sink>
+concept MatchCallback = std::invocable<Sink &, const Message &, const Message &, double>;
+
+struct SearcherOptions
+{
+    std::chrono::milliseconds window{5000}; // lifespan of a stored message
+    // Expiry moves in steps of this size: stored messages expire up to one step late, in batches
+    Clock::duration expiry_granularity = std::chrono::milliseconds(1);
+    std::chrono::milliseconds dedup_interval{0}; // suppress identical messages within the interval, 0 disables
+    unsigned int fuzzy_login_distance = 0;       // logins within this edit distance (1 or 2) add fuzzy_login_weight, 0 disables
+    double fuzzy_login_weight = 0.5;
+    // Different phones sharing their last phone_suffix_digits digits (same subscriber, another
+    // country code) or their first phone_prefix_digits digits add phone_partial_weight, 0 disables
+    unsigned int phone_suffix_digits = 0;
+    unsigned int phone_prefix_digits = 0;
+    double phone_partial_weight = 0.5;
+    // Per-key arrival counts over the storage window are kept in count-min sketches; a phone or
+    // login reaching hot_key_threshold arrivals is reported as hot. 0 disables the tracking
+    uint32_t hot_key_threshold = 0;
+    size_t fanout_cap = 0; // max entries walked per fuzzy login deletion key, see FanoutPolicy. 0 disables
+    FanoutPolicy fanout_policy = FanoutPolicy::keep_newest;
+    // The storage is republished for query() at most this often, on arrival of a message. 0 disables
+    std::chrono::milliseconds snapshot_interval{0};
+    size_t batch_size = 1; // thread mode: messages taken from the container and processed together
+    bool log_matches = true; // log every match with the storage contents, and the expired elements
+    Logger *logger = nullptr; // where log lines go, nothing is logged when null
+    MatchSink on_match{};         // thread and coroutine modes: called with each match
+    MatchBatchSink on_matches{};  // thread and coroutine modes: called with groups of matches
+    size_t match_batch = 64;      // most matches handed to on_matches at once
+    Clock *clock = nullptr; // time source for arrival and expiry, the steady clock when null
+};
+
+class Searcher
+{
+    Container<Message> *_container = nullptr;
+    std::thread _thread;
+    std::atomic<bool> _terminate_flag;
+    Completion _finished; // set when the coroutine mode loop has returned
+
+    using timestamp = Clock::time_point;
+
+    struct Entry;
+    using EntryIt = std::list<Entry>::iterator;
+    using Bucket = KeyIndex<EntryIt>::Bucket;
+    using Handle = KeyIndex<EntryIt>::Handle;
+
+    struct Entry
+    {
+        timestamp time;
+        Message message;
+        uint64_t seq; // arrival order, equal scores are resolved in favour of the oldest
+        timestamp expiry;
+        bool alive = true; // false once matched or evicted, the node is freed lazily
+        std::string digits{}; // phone_digits(message.phone_number), set when partial phone matching is enabled
+        Handle by_pair{}, by_phone{}, by_login{}, by_suffix{}, by_prefix{};
+        size_t pair_hash = 0, phone_hash = 0, login_hash = 0; // of the by_pair, by_phone and by_login keys
+        std::vector<std::string> deletion_keys{}; // deletions(message.login), set when fuzzy matching is enabled
+        std::vector<Handle> by_deletion{};        // by_deletion[i] is the handle under deletion_keys[i]
+    };
+
+    std::list<Entry> _buffer; // buffer queue, newer items in front
+
+    // Min-heap of expiry times with lazy deletion: matched entries stay in the heap (and in _buffer,
+    // not alive) until their expiry is popped or the heap is compacted
+    struct Expiry
+    {
+        timestamp time;
+        uint64_t seq;
+        EntryIt it;
+
+        bool operator>(const Expiry &other) const
+        {
+            return time > other.time || (time == other.time && seq > other.seq);
+        }
+    };
+    std::vector<Expiry> _expiry;
+    size_t _dead = 0; // entries not alive
+    // Indexes over _buffer, so a search doesn't scan the whole storage
+    KeyIndex<EntryIt> _by_pair, _by_phone, _by_login;
+    KeyIndex<EntryIt> _by_deletion; // symmetric deletion index over logins, for fuzzy matching
+    DigitTrie<EntryIt> _by_suffix;  // reversed phone digits
+    DigitTrie<EntryIt> _by_prefix;
+    uint64_t _next_seq = 0;
+    std::optional<Deduplicator> _dedup;
+
+    struct Arrival
+    {
+        timestamp time;
+        uint64_t phone_hash, login_hash;
+    };
+    std::deque<Arrival> _arrivals; // arrivals within the window, oldest in front
+    CountMinSketch _phone_rate, _login_rate;
+    mutable std::mutex _hot_mutex; // hot keys are read by other threads
+    std::unordered_map<std::string, uint64_t> _hot_phones, _hot_logins; // key -> hash
+
+    const unsigned int _fuzzy_distance;
+    const double _fuzzy_weight;
+    const unsigned int _suffix_digits;
+    const unsigned int _prefix_digits;
+    const double _partial_weight;
+    const uint32_t _hot_threshold;
+    Clock &_clock;
+    const std::chrono::milliseconds _window;
+    const Clock::duration _granularity;
+    const size_t _fanout_cap;
+    const FanoutPolicy _fanout_policy;
+    std::atomic<uint64_t> _fanout_cap_hits{0};
+
+    // Immutable copy of the live storage read by query() from other threads. The matching thread
+    // builds a new one and swaps the pointer; readers keep the one they loaded alive. The mutex
+    // only guards the pointer copy and swap, never the building or the lookups
+    struct Snapshot
+    {
+        struct Stored
+        {
+            Message message;
+            timestamp expiry;
+        };
+        std::vector<Stored> entries; // oldest first
+        std::unordered_map<Message::Field, std::vector<uint32_t>> by_phone, by_login; // indexes into entries, ascending
+    };
+    std::shared_ptr<const Snapshot> _snapshot;
+    mutable std::mutex _snapshot_mutex;
+    const std::chrono::milliseconds _snapshot_interval;
+    timestamp _published{};
+    const size_t _batch_size;
+    Logger *const _logger;
+    const bool _log_matches; // and a logger is set
+    std::atomic<uint64_t> _matches{0};
+    const MatchSink _on_match;
+    const MatchBatchSink _on_matches;
+    const size_t _match_batch;
+    std::vector<Match> _pending; // matches not yet handed to _on_matches
+
+    using PairKey = InlineString<64>;
+
+    // Index keys of a message, computed once for the prefetch, the search and the insertion
+    struct Keys
+    {
+        PairKey pair;
+        size_t pair_hash, phone_hash, login_hash;
+    };
+    std::vector<Keys> _batch_keys; // of the batch in process_batch()
+
+    void log(const std::string &line) const
+    {
+        if (_logger)
+            (*_logger)(line);
+    }
+
+    static PairKey pair_key(const Message &msg)
+    {
+        char key[PairKey::inline_capacity];
+        size_t size = msg.phone_number.size() + 1 + msg.login.size();
+        if (size > sizeof(key))
+            return PairKey(msg.phone_number.str().append(1, '\0').append(msg.login.view()));
+        std::memcpy(key, msg.phone_number.data(), msg.phone_number.size());
+        key[msg.phone_number.size()] = '\0';
+        std::memcpy(key + msg.phone_number.size() + 1, msg.login.data(), msg.login.size());
+        return PairKey(std::string_view(key, size));
+    }
+
+    static Keys keys(const Message &msg)
+    {
+        PairKey pair = pair_key(msg);
+        size_t pair_hash = KeyIndex<EntryIt>::hash(pair);
+        return {std::move(pair), pair_hash, KeyIndex<EntryIt>::hash(msg.phone_number), KeyIndex<EntryIt>::hash(msg.login)};
+    }
+
+    std::string suffix_key(const std::string &digits) const
+    {
+        return digits.size() >= _suffix_digits ? std::string(digits.rbegin(), digits.rbegin() + _suffix_digits) : std::string();
+    }
+
+    std::string prefix_key(const std::string &digits) const
+    {
+        return digits.size() >= _prefix_digits ? digits.substr(0, _prefix_digits) : std::string();
+    }
+
+    double score(const Message &msg, const std::string &digits, const Entry &entry) const
+    {
+        const Message &other = entry.message;
+        double result = 0;
+        if (msg.phone_number == other.phone_number)
+            result += 1;
+        else if ((_suffix_digits && !suffix_key(digits).empty() && suffix_key(digits) == suffix_key(entry.digits)) ||
+                 (_prefix_digits && !prefix_key(digits).empty() && prefix_key(digits) == prefix_key(entry.digits)))
+            result += _partial_weight;
+        if (msg.login == other.login)
+            result += 1;
+        else if (_fuzzy_distance && edit_distance(msg.login, other.login, _fuzzy_distance) <= _fuzzy_distance)
+            result += _fuzzy_weight;
+        return result;
+    }
+
+    /**
+     * @brief Stores msg; keys and variants (its deletions(msg.login)) are computed once for search() too
+     */
+    void insert(timestamp time, const Message &msg, const Keys &keys, std::vector<std::string> &&variants)
+    {
+        auto it = _buffer.insert(_buffer.begin(), Entry{time, msg, _next_seq++, expiry_time(time, msg.ttl)}); // newer items infront
+        _expiry.push_back({it->expiry, it->seq, it});
+        std::push_heap(_expiry.begin(), _expiry.end(), std::greater<Expiry>());
+        it->by_pair = _by_pair.insert(keys.pair, keys.pair_hash, it);
+        it->by_phone = _by_phone.insert(msg.phone_number, keys.phone_hash, it);
+        it->by_login = _by_login.insert(msg.login, keys.login_hash, it);
+        it->pair_hash = keys.pair_hash;
+        it->phone_hash = keys.phone_hash;
+        it->login_hash = keys.login_hash;
+        if (_suffix_digits || _prefix_digits)
+            it->digits = phone_digits(msg.phone_number);
+        if (_suffix_digits && it->digits.size() >= _suffix_digits)
+            it->by_suffix = _by_suffix.insert(suffix_key(it->digits), it);
+        if (_prefix_digits && it->digits.size() >= _prefix_digits)
+            it->by_prefix = _by_prefix.insert(prefix_key(it->digits), it);
+        if (_fuzzy_distance)
+        {
+            it->deletion_keys = std::move(variants);
+            it->by_deletion.reserve(it->deletion_keys.size());
+            for (auto &variant : it->deletion_keys)
+                it->by_deletion.push_back(_by_deletion.insert(variant, it));
+        }
+    }
+
+    /**
+     * @brief Passes the entries of a bucket to consider(), which returns whether the entry is a candidate
+     */
+    template <class Consider>
+    static void walk(const Bucket *bucket, Consider &consider)
+    {
+        if (!bucket)
+            return;
+        for (EntryIt it : *bucket)
+            consider(it);
+    }
+
+    /**
+     * @brief walk() over a bucket of the deletion index, buckets above the fanout cap are walked
+     * according to the policy
+     */
+    template <class Consider>
+    void walk_deletions(const Bucket *bucket, Consider &consider)
+    {
+        if (!bucket)
+            return;
+        if (!_fanout_cap || bucket->size() <= _fanout_cap)
+            return walk(bucket, consider);
+
+        ++_fanout_cap_hits;
+        auto it = bucket->begin();
+        switch (_fanout_policy)
+        {
+        case FanoutPolicy::spill:
+        {
+            bool found = false;
+            for (size_t walked = 0; walked < _fanout_cap; ++walked, ++it)
+                found |= consider(*it);
+            if (found)
+                break;
+            // Nothing among the first entries, fall through to the spilled ones
+            [[fallthrough]];
+        }
+        case FanoutPolicy::first_candidate:
+            for (; it != bucket->end(); ++it)
+            {
+                if (consider(*it))
+                    break;
+            }
+            break;
+        case FanoutPolicy::keep_newest:
+            for (it = std::prev(bucket->end(), _fanout_cap); it != bucket->end(); ++it)
+                consider(*it);
+            break;
+        }
+    }
+
+    /**
+     * @brief Removes the entry from every index. Its node stays in _buffer until its expiry is popped
+     */
+    void unlink(EntryIt it)
+    {
+        const Message &msg = it->message;
+        _by_pair.erase(pair_key(msg), it->pair_hash, it->by_pair);
+        _by_phone.erase(msg.phone_number, it->phone_hash, it->by_phone);
+        _by_login.erase(msg.login, it->login_hash, it->by_login);
+        if (_suffix_digits && it->digits.size() >= _suffix_digits)
+            _by_suffix.erase(suffix_key(it->digits), it->by_suffix);
+        if (_prefix_digits && it->digits.size() >= _prefix_digits)
+            _by_prefix.erase(prefix_key(it->digits), it->by_prefix);
+        for (size_t i = 0; i < it->by_deletion.size(); ++i)
+            _by_deletion.erase(it->deletion_keys[i], it->by_deletion[i]);
+        it->alive = false;
+        ++_dead;
+    }
+
+    /**
+     * @brief Frees the nodes of unlinked entries once they outnumber the live ones
+     */
+    void compact()
+    {
+        if (_dead < 1024 || _dead < _buffer.size() / 2)
+            return;
+        std::erase_if(_expiry, [](const Expiry &expiry)
+                      { return !expiry.it->alive; });
+        std::make_heap(_expiry.begin(), _expiry.end(), std::greater<Expiry>());
+        _buffer.remove_if([](const Entry &entry)
+                          { return !entry.alive; });
+        _dead = 0;
+    }
+
+    void track_arrival(timestamp time, const Message &msg)
+    {
+        bool expired = false;
+        while (!_arrivals.empty() && time - _arrivals.front().time >= _window)
+        {
+            _phone_rate.add(_arrivals.front().phone_hash, -1);
+            _login_rate.add(_arrivals.front().login_hash, -1);
+            _arrivals.pop_front();
+            expired = true;
+        }
+
+        Arrival arrival{time, std::hash<Message::Field>{}(msg.phone_number), std::hash<Message::Field>{}(msg.login)};
+        _phone_rate.add(arrival.phone_hash, 1);
+        _login_rate.add(arrival.login_hash, 1);
+        _arrivals.push_back(arrival);
+
+        std::lock_guard<std::mutex> lock(_hot_mutex);
+        if (expired)
+        {
+            std::erase_if(_hot_phones, [this](const auto &key)
+                          { return _phone_rate.estimate(key.second) < _hot_threshold; });
+            std::erase_if(_hot_logins, [this](const auto &key)
+                          { return _login_rate.estimate(key.second) < _hot_threshold; });
+        }
+        uint32_t phone_count = _phone_rate.estimate(arrival.phone_hash);
+        if (phone_count >= _hot_threshold && _hot_phones.emplace(msg.phone_number, arrival.phone_hash).second)
+            log("[Searcher]: Hot phone " + msg.phone_number + ": ~" + std::to_string(phone_count) + " messages within " + std::to_string(_window.count()) + " ms");
+        uint32_t login_count = _login_rate.estimate(arrival.login_hash);
+        if (login_count >= _hot_threshold && _hot_logins.emplace(msg.login, arrival.login_hash).second)
+            log("[Searcher]: Hot login " + msg.login + ": ~" + std::to_string(login_count) + " messages within " + std::to_string(_window.count()) + " ms");
+    }
+
+    /**
+     * @brief When an element stored at time expires: time + ttl (the window by default) rounded up
+     * to the expiry granularity, so the elements of one granularity step expire together
+     */
+    timestamp expiry_time(timestamp time, std::chrono::milliseconds ttl) const
+    {
+        auto deadline = (time + (ttl.count() > 0 ? ttl : _window)).time_since_epoch();
+        return timestamp((deadline + _granularity - Clock::duration(1)) / _granularity * _granularity);
+    }
+
+    void remove_expired()
+    {
+        AllocationScope stage(AllocationStage::expiry);
+        auto time = _clock.now();
+        if (_expiry.empty() || time < _expiry.front().time)
+            return;
+
+        std::string expired_elements;
+        while (!_expiry.empty() && time >= _expiry.front().time)
+        {
+            std::pop_heap(_expiry.begin(), _expiry.end(), std::greater<Expiry>());
+            EntryIt it = _expiry.back().it;
+            _expiry.pop_back();
+            if (it->alive)
+            {
+                // Debug log
+                if (_log_matches)
+                {
+                    AllocationScope logging(AllocationStage::logging);
+                    expired_elements += "\n\t(" + it->message.phone_number + ", " + it->message.login + ")";
+                }
+                unlink(it);
+            }
+            _buffer.erase(it);
+            --_dead;
+        }
+        if (!expired_elements.empty())
+        {
+            AllocationScope logging(AllocationStage::logging);
+            log("[Debug] [Searcher]: Expired elements:" + expired_elements);
+        }
+        // \Debug log
+    }
+
+    void publish(timestamp time)
+    {
+        if (_snapshot_interval.count() <= 0 || (_snapshot && time - _published < _snapshot_interval))
+            return;
+        auto snapshot = std::make_shared<Snapshot>();
+        for (auto it = _buffer.rbegin(); it != _buffer.rend(); ++it)
+        {
+            if (!it->alive)
+                continue;
+            uint32_t index = snapshot->entries.size();
+            snapshot->entries.push_back({it->message, it->expiry});
+            snapshot->by_phone[it->message.phone_number].push_back(index);
+            snapshot->by_login[it->message.login].push_back(index);
+        }
+        // The previous snapshot is freed outside the lock, by the last reader still holding it or here
+        std::shared_ptr<const Snapshot> previous = std::move(snapshot);
+        {
+            std::lock_guard<std::mutex> lock(_snapshot_mutex);
+            _snapshot.swap(previous);
+        }
+        _published = time;
+    }
+
+    struct Candidate
+    {
+        EntryIt it;
+        double score;
+    };
+
+    Candidate search(const Message &msg, const Keys &keys, const std::vector<std::string> &variants)
+    {
+        // Validate container
+        remove_expired();
+
+        // Find candidate: the highest score, the oldest among equal scores
+        Candidate best{_buffer.end(), 0};
+        std::string digits = _suffix_digits || _prefix_digits ? phone_digits(msg.phone_number) : std::string();
+        auto consider = [this, &msg, &digits, &best](EntryIt it)
+        {
+            double score = this->score(msg, digits, *it);
+            if (score > best.score || (score > 0 && score == best.score && it->seq < best.it->seq))
+                best = {it, score};
+            return score > 0;
+        };
+
+        if (auto bucket = _by_pair.find(keys.pair, keys.pair_hash))
+            return {bucket->front(), score(msg, digits, *bucket->front())}; // nothing scores higher
+        if (auto bucket = _by_phone.find(msg.phone_number, keys.phone_hash))
+            consider(bucket->front());
+        if (auto bucket = _by_login.find(msg.login, keys.login_hash))
+            consider(bucket->front());
+        if (_fuzzy_distance)
+        {
+            // Logins within the distance share a deletion variant, or one is a variant of the other
+            walk_deletions(_by_deletion.find(msg.login), consider);
+            for (auto &variant : variants)
+            {
+                walk_deletions(_by_deletion.find(variant), consider);
+                if (auto bucket = _by_login.find(variant))
+                    walk(bucket, consider);
+            }
+        }
+        if (_suffix_digits && digits.size() >= _suffix_digits)
+        {
+            if (auto bucket = _by_suffix.find(suffix_key(digits)))
+                walk(bucket, consider);
+        }
+        if (_prefix_digits && digits.size() >= _prefix_digits)
+        {
+            if (auto bucket = _by_prefix.find(prefix_key(digits)))
+                walk(bucket, consider);
+        }
+        return best;
+    }
+
+    /**
+     * @brief Hands a match of the thread or coroutine mode to the logger and the sinks
+     */
+    void deliver(Match &&match)
+    {
+        if (_log_matches)
+            log_match(*_logger, match);
+        if (_on_match)
+            _on_match(match.incoming, match.stored, match.score);
+        if (_on_matches)
+        {
+            _pending.push_back(std::move(match));
+            if (_pending.size() >= _match_batch)
+                flush_matches();
+        }
+    }
+
+    void flush_matches()
+    {
+        if (_pending.empty())
+            return;
+        _on_matches(_pending);
+        _pending.clear();
+    }
+
+    /**
+     * @brief Computes the keys of a batch into _batch_keys and prefetches what the exact lookups will
+     * touch, one level per pass so the loads of a pass are in flight together: the slots of the three
+     * indexes, their nodes, the oldest entry of each bucket's list, then the stored Entry itself
+     */
+    void prefetch(std::span<const Message> messages)
+    {
+        _batch_keys.clear();
+        for (const Message &msg : messages)
+            _batch_keys.push_back(keys(msg));
+        for (const Keys &keys : _batch_keys)
+        {
+            _by_pair.prefetch_slot(keys.pair_hash);
+            _by_phone.prefetch_slot(keys.phone_hash);
+            _by_login.prefetch_slot(keys.login_hash);
+        }
+        for (const Keys &keys : _batch_keys)
+        {
+            _by_pair.prefetch_node(keys.pair_hash);
+            _by_phone.prefetch_node(keys.phone_hash);
+            _by_login.prefetch_node(keys.login_hash);
+        }
+        for (size_t i = 0; i < messages.size(); ++i)
+        {
+            const Keys &keys = _batch_keys[i];
+            _by_pair.prefetch_bucket(keys.pair, keys.pair_hash);
+            _by_phone.prefetch_bucket(messages[i].phone_number, keys.phone_hash);
+            _by_login.prefetch_bucket(messages[i].login, keys.login_hash);
+        }
+        for (size_t i = 0; i < messages.size(); ++i)
+        {
+            const Keys &keys = _batch_keys[i];
+            for (const Bucket *bucket : {_by_pair.find(keys.pair, keys.pair_hash), _by_phone.find(messages[i].phone_number, keys.phone_hash),
+                                         _by_login.find(messages[i].login, keys.login_hash)})
+            {
+                if (bucket)
+                    __builtin_prefetch(&*bucket->front());
+            }
+        }
+    }
+
+    /**
+     * @brief process() with the keys of msg already computed, by process_batch() for its prefetch
+     */
+    std::optional<Match> process(Message &&msg, const Keys &keys)
+    {
+        AllocationScope stage(AllocationStage::search);
+        if constexpr (allocation_profile)
+            AllocationProfile::messages.fetch_add(1, std::memory_order_relaxed);
+        auto time = _clock.now();
+        if (_dedup && _dedup->is_duplicate(msg, time))
+        {
+            if (_log_matches)
+                log("[Debug] [Searcher]: Dropped duplicate (" + msg.phone_number + ", " + msg.login + ")");
+            return std::nullopt;
+        }
+        if (_hot_threshold)
+            track_arrival(time, msg);
+        std::vector<std::string> variants = _fuzzy_distance ? deletions(msg.login, _fuzzy_distance) : std::vector<std::string>();
+        auto found = search(msg, keys, variants);
+        if (found.it != _buffer.end())
+        {
+            // Debug log
+            if (_log_matches)
+            {
+                AllocationScope logging(AllocationStage::logging);
+                std::string elements;
+                for (auto it = _buffer.begin(); it != _buffer.end(); ++it)
+                {
+                    if (it->alive)
+                        elements += "\n\t(" + it->message.phone_number + ", " + it->message.login + ")";
+                }
+                if (!elements.empty())
+                    log("[Debug] [Searcher]: Internal storage:" + elements);
+            }
+            // \Debug log
+
+            ++_matches;
+            Match match{std::move(msg), found.it->message, found.score};
+            unlink(found.it);
+            compact();
+            publish(time);
+            return match;
+        }
+        insert(time, msg, keys, std::move(variants));
+        publish(time);
+        return std::nullopt;
+    }
+
+    Task run(Scheduler &scheduler)
+    {
+        while (!_terminate_flag)
+        {
+            if (_container->empty())
+                flush_matches();
+            auto msg = co_await _container->pop_async(scheduler, _terminate_flag);
+            if (msg)
+            {
+                if (auto match = process(std::move(*msg)))
+                    deliver(std::move(*match));
+            }
+        }
+        _finished.set(); // last access to *this
+    }
+
+public:
+    /**
+     * @brief Inline mode: no thread is started, the owner feeds messages through process()
+     */
+    Searcher(const SearcherOptions &options = {})
+        : _fuzzy_distance(std::min(options.fuzzy_login_distance, 2u)), _fuzzy_weight(options.fuzzy_login_weight),
+          _suffix_digits(options.phone_suffix_digits), _prefix_digits(options.phone_prefix_digits),
+          _partial_weight(options.phone_partial_weight), _hot_threshold(options.hot_key_threshold),
+          _clock(options.clock ? *options.clock : SteadyClock::instance()),
+          _window(options.window), _granularity(std::max(options.expiry_granularity, Clock::duration(1))),
+          _fanout_cap(options.fanout_cap), _fanout_policy(options.fanout_policy),
+          _snapshot_interval(options.snapshot_interval), _batch_size(std::max<size_t>(options.batch_size, 1)),
+          _logger(options.logger), _log_matches(options.log_matches && options.logger),
+          _on_match(options.on_match), _on_matches(options.on_matches), _match_batch(std::max<size_t>(options.match_batch, 1))
+    {
+        _terminate_flag = false;
+        if (options.dedup_interval.count() > 0)
+            _dedup.emplace(options.dedup_interval);
+    }
+
+    template <class Queue>
+        requires requires(Queue &queue) { queue.pop(); }
+    Searcher(Queue &container, const SearcherOptions &options = {}) : Searcher(options)
+    {
+        _thread = std::thread([this, &container]()
+            {
+                std::vector<Message> batch;
+                while (!_terminate_flag)
+                {
+                    if (container.empty())
+                    {
+                        flush_matches();
+                    }
+                    else
+                    {
+                        if constexpr (requires(std::vector<Message> &out) { container.pop_batch(out, _batch_size); })
+                        {
+                            if (_batch_size > 1)
+                            {
+                                batch.clear();
+                                container.pop_batch(batch, _batch_size); // blocks thread until message receiving
+                                for (auto &match : process_batch(batch))
+                                    deliver(std::move(match));
+                                continue;
+                            }
+                        }
+                        auto match = [this, &container]()
+                        {
+                            auto message = container.pop(); // blocks thread until message receiving
+                            if constexpr (std::is_same_v<decltype(message), Message>)
+                                return process(std::move(message));
+                            else
+                                return process(std::move(*message)); // leased slot, released on return
+                        }();
+                        if (match)
+                            deliver(std::move(*match));
+                    }
+                }
+            });
+    };
+
+    /**
+     * @brief Coroutine mode: awaits the container on the scheduler's pool instead of owning a thread
+     */
+    Searcher(Container<Message> &container, Scheduler &scheduler, const SearcherOptions &options = {}) : Searcher(options)
+    {
+        _container = &container;
+        scheduler.spawn(run(scheduler));
+    }
+
+    ~Searcher()
+    {
+        _terminate_flag = true;
+        if (_thread.joinable())
+        {
+            _thread.join();
+        }
+        else if (_container)
+        {
+            _container->notify_waiters();
+            _finished.wait();
+        }
+        flush_matches(); // the matching thread or coroutine is done
+
+        if (_dedup)
+            log("[Searcher]: Dropped duplicates: " + std::to_string(_dedup->dropped()));
+        if (_fanout_cap_hits)
+            log("[Searcher]: Fanout cap triggered: " + std::to_string(_fanout_cap_hits) + " times");
+    }
+
+    /**
+     * @brief Searches the internal storage for the best candidate of msg.
+     * The candidate is removed and returned, otherwise msg is stored for further comparisons
+     * 
+     * @return std::optional<Match>
+     */
+    std::optional<Match> process(Message &&msg)
+    {
+        Keys message_keys = keys(msg);
+        return process(std::move(msg), message_keys);
+    }
+
+    /**
+     * @brief Same as calling process() on each message in order, so a message can match one stored
+     * earlier in the batch. The index buckets of the whole batch are prefetched first, hiding the cache
+     * misses of a large storage behind each other instead of taking them one message at a time
+     * 
+     * @return std::vector<Match> matches in the order of the messages
+     */
+    std::vector<Match> process_batch(std::span<Message> messages)
+    {
+        prefetch(messages);
+        std::vector<Match> matches;
+        for (size_t i = 0; i < messages.size(); ++i)
+        {
+            if (auto match = process(std::move(messages[i]), _batch_keys[i]))
+                matches.push_back(std::move(*match));
+        }
+        return matches;
+    }
+
+    /**
+     * @brief process_batch() handing each match to sink as it is found instead of collecting them.
+     * The sink type is known at compile time, so the call is inlined
+     */
+    template <MatchCallback Sink>
+    void process_batch(std::span<Message> messages, Sink &&sink)
+    {
+        prefetch(messages);
+        for (size_t i = 0; i < messages.size(); ++i)
+        {
+            if (auto match = process(std::move(messages[i]), _batch_keys[i]))
+                sink(match->incoming, match->stored, match->score);
+        }
+    }
+
+    /**
+     * @brief Read-only lookup, may be called from any thread and never blocks the matching thread:
+     * ranks msg against the last published snapshot (see SearcherOptions::snapshot_interval) by
+     * exact phone and login equality, without consuming the stored message. Expired entries are
+     * skipped; entries matched since the snapshot was published may still be reported
+     * 
+     * @return std::optional<Match> the best stored message, the oldest among equal ranks
+     */
+    std::optional<Match> query(const Message &msg) const
+    {
+        std::shared_ptr<const Snapshot> snapshot;
+        {
+            std::lock_guard<std::mutex> lock(_snapshot_mutex);
+            snapshot = _snapshot;
+        }
+        if (!snapshot)
+            return std::nullopt;
+        auto time = _clock.now();
+        const Snapshot::Stored *best = nullptr;
+        uint32_t best_index = 0;
+        double best_score = 0;
+        auto consider = [&](const std::unordered_map<Message::Field, std::vector<uint32_t>> &index, const Message::Field &key)
+        {
+            auto bucket = index.find(key);
+            if (bucket == index.end())
+                return;
+            for (uint32_t i : bucket->second)
+            {
+                const Snapshot::Stored &stored = snapshot->entries[i];
+                if (time >= stored.expiry)
+                    continue;
+                double score = (stored.message.phone_number == msg.phone_number) + (stored.message.login == msg.login);
+                if (score > best_score || (score == best_score && i < best_index))
+                {
+                    best = &stored;
+                    best_index = i;
+                    best_score = score;
+                }
+            }
+        };
+        consider(snapshot->by_phone, msg.phone_number);
+        if (best_score < 2)
+            consider(snapshot->by_login, msg.login);
+        if (!best)
+            return std::nullopt;
+        return Match{msg, best->message, best_score};
+    }
+
+    /**
+     * @brief Estimated arrivals of the phone number within the window, may be called from any thread.
+     * Requires SearcherOptions::hot_key_threshold
+     */
+    uint32_t phone_rate(const std::string &phone_number) const
+    {
+        return _phone_rate.estimate(std::hash<std::string>{}(phone_number));
+    }
+
+    uint32_t login_rate(const std::string &login) const
+    {
+        return _login_rate.estimate(std::hash<std::string>{}(login));
+    }
+
+    /**
+     * @brief Phones and logins currently at or above the hot key threshold, with their estimated rates
+     */
+    std::vector<std::pair<std::string, uint32_t>> hot_phones() const
+    {
+        std::lock_guard<std::mutex> lock(_hot_mutex);
+        std::vector<std::pair<std::string, uint32_t>> result;
+        for (auto &[phone, hash] : _hot_phones)
+            result.emplace_back(phone, _phone_rate.estimate(hash));
+        return result;
+    }
+
+    /**
+     * @brief Messages matched so far, may be called from any thread
+     */
+    uint64_t matches() const
+    {
+        return _matches;
+    }
+
+    /**
+     * @brief How many times a key exceeded SearcherOptions::fanout_cap, may be called from any thread
+     */
+    uint64_t fanout_cap_hits() const
+    {
+        return _fanout_cap_hits;
+    }
+
+    std::vector<std::pair<std::string, uint32_t>> hot_logins() const
+    {
+        std::lock_guard<std::mutex> lock(_hot_mutex);
+        std::vector<std::pair<std::string, uint32_t>> result;
+        for (auto &[login, hash] : _hot_logins)
+            result.emplace_back(login, _login_rate.estimate(hash));
+        return result;
+    }
+};
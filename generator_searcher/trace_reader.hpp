@@ -0,0 +1,486 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "message.hpp"
+
+/**
+ * @brief One line of a trace: "<milliseconds> <phone_number> <login> [ttl milliseconds]"
+ */
+struct TraceRecord
+{
+    std::chrono::milliseconds time;
+    Message message;
+};
+
+/**
+ * @brief Parses a trace line, std::nullopt for lines without the three mandatory fields
+ */
+inline std::optional<TraceRecord> parse_trace_record(std::string_view line)
+{
+    // Plain loops: find_first_of() with a character set costs more than the rest of the parsing
+    auto blank = [](char c)
+    { return c == ' ' || c == '\t' || c == '\r'; };
+    size_t position = 0;
+    auto next_field = [&]()
+    {
+        while (position < line.size() && blank(line[position]))
+            ++position;
+        size_t begin = position;
+        while (position < line.size() && !blank(line[position]))
+            ++position;
+        return line.substr(begin, position - begin);
+    };
+    auto number = [](std::string_view field, long long &value)
+    {
+        return !field.empty() && std::from_chars(field.data(), field.data() + field.size(), value).ec == std::errc();
+    };
+    long long milliseconds, ttl = 0;
+    std::string_view time = next_field(), phone_number = next_field(), login = next_field();
+    if (!number(time, milliseconds) || login.empty())
+        return std::nullopt;
+    if (!number(next_field(), ttl))
+        ttl = 0;
+    return TraceRecord{std::chrono::milliseconds(milliseconds), Message(phone_number, login, std::chrono::milliseconds(ttl))};
+}
+
+struct TraceReaderOptions
+{
+    size_t chunk_size = 1 << 20;  // bytes per read
+    unsigned int queue_depth = 8; // reads in flight
+    bool use_uring = true;        // pread() one chunk at a time when false or when io_uring is unavailable
+};
+
+/**
+ * @brief Reads a trace file in large chunks. With io_uring, queue_depth reads into registered buffers
+ * are in flight while the chunk that completed first in file order is parsed, and each parsed buffer is
+ * immediately queued again for the next chunk. Falls back to pread() when io_uring can't be set up or
+ * the kernel lacks the read opcode
+ */
+class TraceReader
+{
+    struct Slot
+    {
+        uint64_t offset = 0;
+        size_t length = 0;
+        int result = 0;
+        bool done = false;
+    };
+
+    int _fd = -1;
+    uint64_t _size = 0;
+    const size_t _chunk_size;
+    std::vector<Slot> _slots;
+    char *_buffers = nullptr; // one chunk per slot, page aligned
+    size_t _buffers_size = 0;
+    uint64_t _next_read = 0;  // offset of the next chunk to queue
+    uint64_t _next_parse = 0; // offset of the next chunk to parse
+    std::string _carry;       // line split across two chunks
+    uint64_t _bytes = 0;
+
+    // io_uring, driven through the raw system calls
+    int _ring_fd = -1;
+    bool _fixed_buffers = false;
+    void *_sq_ring = nullptr, *_cq_ring = nullptr;
+    size_t _sq_ring_size = 0, _cq_ring_size = 0;
+    io_uring_sqe *_sqes = nullptr;
+    size_t _sqes_size = 0;
+    unsigned *_sq_tail = nullptr, *_sq_mask = nullptr, *_sq_array = nullptr;
+    unsigned *_cq_head = nullptr, *_cq_tail = nullptr, *_cq_mask = nullptr;
+    io_uring_cqe *_cqes = nullptr;
+    unsigned _to_submit = 0;
+
+    static unsigned *field(void *ring, uint32_t offset)
+    {
+        return reinterpret_cast<unsigned *>(static_cast<char *>(ring) + offset);
+    }
+
+    bool setup_uring(unsigned int depth)
+    {
+        io_uring_params params{};
+        _ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, depth, &params));
+        if (_ring_fd < 0)
+            return false;
+        _sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        _cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+            _sq_ring_size = _cq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+        _sq_ring = mmap(nullptr, _sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQ_RING);
+        if (_sq_ring == MAP_FAILED)
+            return _sq_ring = nullptr, false;
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+        {
+            _cq_ring = _sq_ring;
+        }
+        else
+        {
+            _cq_ring = mmap(nullptr, _cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_CQ_RING);
+            if (_cq_ring == MAP_FAILED)
+                return _cq_ring = nullptr, false;
+        }
+        _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        void *sqes = mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+            return false;
+        _sqes = static_cast<io_uring_sqe *>(sqes);
+        _sq_tail = field(_sq_ring, params.sq_off.tail);
+        _sq_mask = field(_sq_ring, params.sq_off.ring_mask);
+        _sq_array = field(_sq_ring, params.sq_off.array);
+        _cq_head = field(_cq_ring, params.cq_off.head);
+        _cq_tail = field(_cq_ring, params.cq_off.tail);
+        _cq_mask = field(_cq_ring, params.cq_off.ring_mask);
+        _cqes = reinterpret_cast<io_uring_cqe *>(static_cast<char *>(_cq_ring) + params.cq_off.cqes);
+
+        // Registered buffers skip the page pinning of every read; plain reads still work without them
+        std::vector<iovec> buffers(_slots.size());
+        for (size_t i = 0; i < _slots.size(); ++i)
+            buffers[i] = {_buffers + i * _chunk_size, _chunk_size};
+        _fixed_buffers = syscall(__NR_io_uring_register, _ring_fd, IORING_REGISTER_BUFFERS, buffers.data(), buffers.size()) == 0;
+
+        // IORING_OP_READ and the probe both came with 5.6: without a probe only READ_FIXED (5.1) is known to work
+        unsigned opcode = _fixed_buffers ? IORING_OP_READ_FIXED : IORING_OP_READ;
+        std::vector<char> probe_buffer(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op));
+        auto *probe = reinterpret_cast<io_uring_probe *>(probe_buffer.data());
+        if (syscall(__NR_io_uring_register, _ring_fd, IORING_REGISTER_PROBE, probe, 256) == 0)
+            return opcode < probe->ops_len && (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED);
+        return _fixed_buffers;
+    }
+
+    void teardown_uring()
+    {
+        if (_sqes)
+            munmap(_sqes, _sqes_size);
+        if (_cq_ring && _cq_ring != _sq_ring)
+            munmap(_cq_ring, _cq_ring_size);
+        if (_sq_ring)
+            munmap(_sq_ring, _sq_ring_size);
+        if (_ring_fd >= 0)
+            close(_ring_fd);
+        _ring_fd = -1;
+        _sqes = nullptr;
+        _sq_ring = _cq_ring = nullptr;
+    }
+
+    /**
+     * @brief Queues a read of the next chunk into a free slot, submitted with the next wait
+     */
+    void queue_read(size_t slot)
+    {
+        Slot &s = _slots[slot];
+        s = {_next_read, static_cast<size_t>(std::min<uint64_t>(_chunk_size, _size - _next_read)), 0, false};
+        _next_read += s.length;
+
+        unsigned tail = std::atomic_ref<unsigned>(*_sq_tail).load(std::memory_order_relaxed);
+        unsigned index = tail & *_sq_mask;
+        io_uring_sqe &sqe = _sqes[index];
+        sqe = {};
+        sqe.opcode = _fixed_buffers ? IORING_OP_READ_FIXED : IORING_OP_READ;
+        sqe.fd = _fd;
+        sqe.addr = reinterpret_cast<uint64_t>(_buffers + slot * _chunk_size);
+        sqe.len = static_cast<uint32_t>(s.length);
+        sqe.off = s.offset;
+        sqe.buf_index = static_cast<uint16_t>(slot);
+        sqe.user_data = slot;
+        _sq_array[index] = index;
+        std::atomic_ref<unsigned>(*_sq_tail).store(tail + 1, std::memory_order_release);
+        ++_to_submit;
+    }
+
+    /**
+     * @brief Submits the queued reads and waits until the read of the given slot has completed
+     *
+     * @return 0, or the errno of a failed io_uring_enter()
+     */
+    int wait(size_t slot) noexcept
+    {
+        while (!_slots[slot].done)
+        {
+            unsigned head = std::atomic_ref<unsigned>(*_cq_head).load(std::memory_order_relaxed);
+            unsigned tail = std::atomic_ref<unsigned>(*_cq_tail).load(std::memory_order_acquire);
+            if (head == tail)
+            {
+                long entered = syscall(__NR_io_uring_enter, _ring_fd, _to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+                if (entered < 0 && errno != EINTR)
+                    return errno;
+                if (entered > 0)
+                    _to_submit -= static_cast<unsigned>(entered);
+                continue;
+            }
+            for (; head != tail; ++head)
+            {
+                const io_uring_cqe &cqe = _cqes[head & *_cq_mask];
+                _slots[cqe.user_data].result = cqe.res;
+                _slots[cqe.user_data].done = true;
+            }
+            std::atomic_ref<unsigned>(*_cq_head).store(head, std::memory_order_release);
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Waits for every read in flight
+     *
+     * @return 0, or the errno of a failed io_uring_enter(): reads may still target the buffers then
+     */
+    int wait_all() noexcept
+    {
+        for (size_t slot = 0; slot < _slots.size(); ++slot)
+        {
+            if (_slots[slot].length && !_slots[slot].done)
+            {
+                if (int error = wait(slot))
+                    return error;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Reads what a short read left out of a chunk, synchronously
+     */
+    void complete(size_t slot, size_t done)
+    {
+        const Slot &s = _slots[slot];
+        while (done < s.length)
+        {
+            ssize_t result = pread(_fd, _buffers + slot * _chunk_size + done, s.length - done, static_cast<off_t>(s.offset + done));
+            if (result < 0 && errno == EINTR)
+                continue;
+            if (result <= 0)
+                throw std::system_error(result < 0 ? errno : EIO, std::generic_category(), "pread");
+            done += static_cast<size_t>(result);
+        }
+    }
+
+    void parse(const char *data, size_t length, std::vector<TraceRecord> &out)
+    {
+        std::string_view chunk(data, length);
+        size_t newline = chunk.find('\n');
+        if (newline == std::string_view::npos)
+        {
+            _carry.append(chunk);
+            return;
+        }
+        if (!_carry.empty())
+        {
+            _carry.append(chunk.substr(0, newline));
+            if (auto record = parse_trace_record(_carry))
+                out.push_back(std::move(*record));
+            _carry.clear();
+        }
+        else if (auto record = parse_trace_record(chunk.substr(0, newline)))
+        {
+            out.push_back(std::move(*record));
+        }
+        for (size_t begin = newline + 1;; begin = newline + 1)
+        {
+            newline = chunk.find('\n', begin);
+            if (newline == std::string_view::npos)
+            {
+                _carry.assign(chunk.substr(begin));
+                return;
+            }
+            if (auto record = parse_trace_record(chunk.substr(begin, newline - begin)))
+                out.push_back(std::move(*record));
+        }
+    }
+
+public:
+    explicit TraceReader(const std::string &path, const TraceReaderOptions &options = {})
+        : _chunk_size(std::max<size_t>(options.chunk_size, 4096)), _slots(std::max(options.queue_depth, 1u))
+    {
+        _fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (_fd < 0)
+            throw std::system_error(errno, std::generic_category(), path);
+        struct stat status;
+        if (fstat(_fd, &status) != 0)
+        {
+            int error = errno;
+            close(_fd);
+            throw std::system_error(error, std::generic_category(), path);
+        }
+        _size = static_cast<uint64_t>(status.st_size);
+        if (!options.use_uring)
+            _slots.resize(1);
+        _buffers_size = _slots.size() * _chunk_size;
+        void *buffers = mmap(nullptr, _buffers_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buffers == MAP_FAILED)
+        {
+            int error = errno;
+            close(_fd);
+            throw std::system_error(error, std::generic_category(), "mmap");
+        }
+        _buffers = static_cast<char *>(buffers);
+
+        if (options.use_uring && !setup_uring(static_cast<unsigned int>(_slots.size())))
+        {
+            teardown_uring();
+            _slots.resize(1); // pread() needs a single buffer
+        }
+        if (_ring_fd >= 0)
+        {
+            for (size_t slot = 0; slot < _slots.size() && _next_read < _size; ++slot)
+                queue_read(slot);
+        }
+    }
+
+    ~TraceReader()
+    {
+        // Reads still in flight target the buffers: let them finish first, and leak the buffers
+        // rather than unmap them under reads that could not be reaped
+        bool reaped = _ring_fd < 0 || wait_all() == 0;
+        teardown_uring();
+        if (reaped)
+            munmap(_buffers, _buffers_size);
+        close(_fd);
+    }
+
+    TraceReader(const TraceReader &) = delete;
+    TraceReader &operator=(const TraceReader &) = delete;
+
+    /**
+     * @brief Whether reads go through io_uring, false when it fell back to pread()
+     */
+    bool uring() const
+    {
+        return _ring_fd >= 0;
+    }
+
+    /**
+     * @brief Whether the io_uring reads use registered buffers
+     */
+    bool fixed_buffers() const
+    {
+        return _fixed_buffers;
+    }
+
+    /**
+     * @brief Bytes of the file parsed so far
+     */
+    uint64_t bytes() const
+    {
+        return _bytes;
+    }
+
+    /**
+     * @brief Waits for the next chunk in file order and appends its records to out; a record split
+     * across chunks is emitted with the later one
+     *
+     * @return false once the whole file has been read, out is left untouched then
+     */
+    bool read(std::vector<TraceRecord> &out)
+    {
+        if (_next_parse >= _size)
+        {
+            if (_carry.empty())
+                return false;
+            if (auto record = parse_trace_record(_carry))
+                out.push_back(std::move(*record));
+            _carry.clear();
+            return true;
+        }
+        size_t slot = (_next_parse / _chunk_size) % _slots.size();
+        if (_ring_fd >= 0)
+        {
+            if (int error = wait(slot))
+                throw std::system_error(error, std::generic_category(), "io_uring_enter");
+            if (_slots[slot].result == -EINVAL)
+            {
+                // The kernel rejects the read opcode after all: finish with pread() from this chunk on
+                if (int error = wait_all())
+                    throw std::system_error(error, std::generic_category(), "io_uring_enter");
+                teardown_uring();
+                _fixed_buffers = false;
+            }
+            else if (_slots[slot].result < 0)
+            {
+                throw std::system_error(-_slots[slot].result, std::generic_category(), "io_uring read");
+            }
+            else
+            {
+                complete(slot, static_cast<size_t>(_slots[slot].result));
+            }
+        }
+        if (_ring_fd < 0)
+        {
+            _slots[slot] = {_next_parse, static_cast<size_t>(std::min<uint64_t>(_chunk_size, _size - _next_parse)), 0, true};
+            complete(slot, 0);
+        }
+        size_t length = _slots[slot].length;
+        parse(_buffers + slot * _chunk_size, length, out);
+        _next_parse += length;
+        _bytes += length;
+        _slots[slot].length = 0;
+        if (_ring_fd >= 0 && _next_read < _size)
+            queue_read(slot);
+        return true;
+    }
+};
+
+/**
+ * @brief Feeds the messages of a trace to a container in bulk, one chunk of records at a time, as fast
+ * as it takes them. Timestamps are dropped: consumers stamp messages with their own clock, use replay()
+ * for the trace's timing. Waits while more than max_queued are queued: blocked in wait_for_room() when
+ * the container has one, polling a size() otherwise
+ *
+ * @return number of messages pushed
+ */
+template <class Queue>
+uint64_t ingest_trace(TraceReader &reader, Queue &container, size_t max_queued = 1 << 16)
+{
+    uint64_t messages = 0;
+    std::vector<TraceRecord> records;
+    std::vector<Message> batch;
+    while (reader.read(records))
+    {
+        for (auto &record : records)
+            batch.push_back(std::move(record.message));
+        records.clear();
+        messages += batch.size();
+        if constexpr (requires { container.wait_for_room(max_queued); })
+        {
+            container.wait_for_room(max_queued);
+        }
+        else if constexpr (requires { container.size(); })
+        {
+            for (int idle = 0; container.size() > max_queued; ++idle)
+            {
+                if (idle < 16)
+                    std::this_thread::yield();
+                else
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+        if constexpr (requires { container.push_batch(std::span<Message>(batch)); })
+        {
+            container.push_batch(batch);
+        }
+        else
+        {
+            for (auto &msg : batch)
+                container.push(std::move(msg));
+        }
+        batch.clear();
+    }
+    return messages;
+}
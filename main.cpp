@@ -1,226 +1,461 @@
-#include <iostream>
-#include <chrono>
-#include <thread>
-#include <atomic>
-#include <queue>
-#include <mutex>
-#include <list>
-#include <optional>
-#include <condition_variable>
-#include <algorithm>
-#include <string>
-#include <time.h>
-
-// Thread-safe std::cout
-void log(const std::string &&str)
+#include "generator_searcher.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <new>
+#include <sstream>
+
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#ifdef ALLOCATION_PROFILE
+void *operator new(std::size_t size)
 {
-    static std::mutex _m;
-    std::lock_guard<std::mutex> lock(_m);
-    std::cout << str << std::endl;
+    AllocationProfile::record(size);
+    if (void *pointer = std::malloc(size ? size : 1))
+        return pointer;
+    throw std::bad_alloc();
 }
 
-struct Message
+void *operator new(std::size_t size, std::align_val_t alignment)
 {
-    const std::string phone_number;
-    const std::string login;
+    AllocationProfile::record(size);
+    size_t align = static_cast<size_t>(alignment);
+    if (void *pointer = std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1) / align * align))
+        return pointer;
+    throw std::bad_alloc();
+}
 
-    Message(const std::string &&_phone_number, const std::string &&_login) : phone_number(_phone_number), login(_login){};
+// GCC pairs operator new with its own delete only and flags free() once both are inlined
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
 
-    bool IsValid()
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::align_val_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t, std::align_val_t) noexcept
+{
+    std::free(pointer);
+}
+#pragma GCC diagnostic pop
+
+// Destroyed after main() returns, std::cout outlives it
+static const struct AllocationReport
+{
+    ~AllocationReport()
     {
-        return !phone_number.empty() || !login.empty();
+        AllocationProfile::report();
     }
-};
+} allocation_report;
+#endif
 
 /**
- * @brief Thread-safe shared container, implemented as queue  
- * 
- * @tparam MessageType 
+ * @brief Command line: "--mode" followed by positional arguments, options are given as "--name=value" anywhere
  */
-template <class MessageType>
-class Container
+struct Arguments
 {
-private:
-    std::queue<MessageType> _container;
-    std::mutex _mutex;
-    std::condition_variable _cv;
+    std::string mode;
+    std::vector<std::string> positional;
+    std::unordered_map<std::string, std::string> options;
 
-public:
-    void push(MessageType &&message)
+    Arguments(int argc, char **argv)
     {
-        std::lock_guard<std::mutex> lock(_mutex);
-        _container.push(message);
-        _cv.notify_one();
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto equals = arg.find('=');
+            if (arg.rfind("--", 0) == 0 && equals != std::string::npos)
+                options[arg.substr(2, equals - 2)] = arg.substr(equals + 1);
+            else if (arg.rfind("--", 0) == 0 && mode.empty())
+                mode = arg.substr(2);
+            else
+                positional.push_back(arg);
+        }
     }
 
-    /**
-     * @brief Blocks the thread until element is received from the container
-     * 
-     * @return MessageType
-     */
-    MessageType pop()
+    unsigned long number(size_t index, unsigned long default_value) const
     {
-        std::unique_lock<std::mutex> lock(_mutex);
-        _cv.wait(lock, [this]()
-                 { return !_container.empty(); });
-        MessageType result = std::move(_container.front());
-        _container.pop();
-        lock.unlock();
-        return std::move(result);
+        return index < positional.size() ? std::stoul(positional[index]) : default_value;
     }
 
-    bool empty()
+    unsigned long option(const std::string &name, unsigned long default_value) const
     {
-        return _container.empty();
+        auto it = options.find(name);
+        return it != options.end() ? std::stoul(it->second) : default_value;
     }
-};
 
-class Generator
-{
-    Container<Message> &_container;
-    std::thread _thread;
-    std::atomic<bool> _terminate_flag;
-
-public:
-    Generator(Container<Message> &container) : _container(container)
+    std::string text(const std::string &name, const std::string &default_value) const
     {
-        _terminate_flag = false;
-        _thread = std::thread([](Container<Message> &container, std::atomic<bool> &terminate)
-            {
-                srand(time(0));
-                std::string number, login;
-                while (!terminate)
-                {
-                    static int i = 0;
-                    number = "+7-915-XXX-XX-0" + std::to_string(i % 7);
-                    login = std::string("login_") + char(97 + (rand() % 10));
-                    ++i;
-                    Message msg(std::move(number), std::move(login));
-                    log("[Debug] [Generator]: Adding (" + msg.phone_number + ", " + msg.login + ")");
-                    container.push(std::move(msg));
-                    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-                }
-            },
-            std::ref(_container), std::ref(_terminate_flag));
-    };
+        auto it = options.find(name);
+        return it != options.end() ? it->second : default_value;
+    }
 
-    ~Generator()
+    /**
+     * @brief Comma separated option, "--name=a,b,c"
+     */
+    std::vector<std::string> list(const std::string &name, const std::string &default_value) const
     {
-        _terminate_flag = true;
-        _thread.join();
+        std::vector<std::string> result;
+        std::istringstream values(text(name, default_value));
+        for (std::string value; std::getline(values, value, ',');)
+            result.push_back(value);
+        return result;
     }
 };
 
-class Searcher
+int main(int argc, char **argv)
 {
-    Container<Message> &_container;
-    std::thread _thread;
-    std::atomic<bool> _terminate_flag;
-
-    using timestamp = std::chrono::steady_clock::time_point;
-    std::list<std::pair<timestamp, Message>> _buffer; // buffer queue
-    const unsigned int _delay = 5;
+    Arguments arguments(argc, argv);
+    Logger log;
+    Container<Message> shared_container;
+    GeneratorOptions generator_options;
+    generator_options.logger = &log;
+    generator_options.interval = std::chrono::milliseconds(arguments.option("interval", 1000));
+    generator_options.log_messages = arguments.option("log-generator", 1) != 0;
+    SearcherOptions searcher_options;
+    searcher_options.logger = &log;
+    searcher_options.log_matches = arguments.option("log-matches", 1) != 0;
+    searcher_options.window = std::chrono::milliseconds(arguments.option("window", 5000));
+    searcher_options.expiry_granularity = std::chrono::milliseconds(arguments.option("granularity", 1));
+    searcher_options.dedup_interval = std::chrono::milliseconds(arguments.option("dedup", 0));
+    searcher_options.fuzzy_login_distance = arguments.option("fuzzy", 0);
+    searcher_options.phone_suffix_digits = arguments.option("phone-suffix", 0);
+    searcher_options.phone_prefix_digits = arguments.option("phone-prefix", 0);
+    searcher_options.hot_key_threshold = arguments.option("hot-keys", 0);
+    searcher_options.fanout_cap = arguments.option("fanout-cap", 0);
+    searcher_options.snapshot_interval = std::chrono::milliseconds(arguments.option("snapshot", 0));
+    searcher_options.batch_size = arguments.option("batch", 1);
+    std::string fanout_policy = arguments.text("fanout-policy", "newest");
+    searcher_options.fanout_policy = fanout_policy == "first" ? FanoutPolicy::first_candidate
+                                   : fanout_policy == "spill" ? FanoutPolicy::spill
+                                                              : FanoutPolicy::keep_newest;
 
-    void remove_expired()
+    if (arguments.mode == "coroutines")
     {
-        auto time = std::chrono::steady_clock::now();
-        auto first_expired = std::find_if(_buffer.begin(), _buffer.end(),
-            [this, &time](const std::pair<Searcher::timestamp, Message> &elem)
-            {
-                auto diff = std::chrono::duration_cast<std::chrono::seconds>(time - elem.first);
-                return diff.count() >= _delay;
-            });
-        // All elements after first_expired are expired too
-        if (first_expired != _buffer.end())
+        // Usage: --coroutines [generators] [searchers] [pool threads]
+        unsigned long generators_count = arguments.number(0, 1);
+        unsigned long searchers_count = arguments.number(1, 1);
+        unsigned int threads = arguments.number(2, std::max(1u, std::thread::hardware_concurrency()));
+
+        Scheduler scheduler(threads);
         {
-            // Debug log
-            std::string expired_elements;
-            for (auto it = first_expired; it != _buffer.end(); ++it)
-            {
-                expired_elements += "\n\t(" + it->second.phone_number + ", " + it->second.login + ")";
-            }
-            log("[Debug] [Searcher]: Expired elements with delay " + std::to_string(_delay) + "s:" + expired_elements);
-            // \Debug log
+            std::list<Generator> generators;
+            std::list<Searcher> searchers;
+            for (unsigned long i = 0; i < generators_count; ++i)
+                generators.emplace_back(shared_container, scheduler, generator_options);
+            for (unsigned long i = 0; i < searchers_count; ++i)
+                searchers.emplace_back(shared_container, scheduler, searcher_options);
 
-            _buffer.erase(first_expired, _buffer.end());
+            std::this_thread::sleep_for(std::chrono::seconds(50));
         }
+        return 0;
     }
 
-    std::list<std::pair<Searcher::timestamp, Message>>::iterator search(const Message &msg)
+    if (arguments.mode == "trace")
     {
-        // Validate container
-        remove_expired();
+        // Usage: --trace <file> [messages] [interval ms] [seed]
+        std::ofstream trace(arguments.positional.at(0));
+        write_trace(trace, arguments.number(1, 3600), std::chrono::milliseconds(arguments.number(2, 1000)), arguments.number(3, 0));
+        return 0;
+    }
 
-        // Find candidate
-        auto best_candidate = _buffer.end();
-        unsigned int max_score = 0;
-        for (auto it = _buffer.rbegin(); it != _buffer.rend(); ++it)
+    TraceReaderOptions reader_options;
+    reader_options.chunk_size = arguments.option("chunk", 1024) * 1024;
+    reader_options.queue_depth = arguments.option("depth", 8);
+    reader_options.use_uring = arguments.text("reader", "uring") == "uring";
+
+    if (arguments.mode == "replay")
+    {
+        // Usage: --replay <file> [--reader=uring|pread|stream]
+        SimulatedClock clock;
+        searcher_options.clock = &clock;
+        Searcher searcher(searcher_options);
+        auto start = std::chrono::steady_clock::now();
+        ReplayStats stats;
+        Logger *match_log = searcher_options.log_matches ? &log : nullptr;
+        if (arguments.text("reader", "uring") == "stream")
+        {
+            std::ifstream trace(arguments.positional.at(0));
+            stats = replay(trace, searcher, clock, match_log);
+        }
+        else
+        {
+            TraceReader reader(arguments.positional.at(0), reader_options);
+            stats = replay(reader, searcher, clock, match_log);
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        log("[Replay]: " + std::to_string(stats.messages) + " messages, " + std::to_string(stats.matches) + " matches, " +
+            std::to_string(stats.span.count() / 1000) + "s of traffic replayed in " + std::to_string(elapsed.count()) + " ms");
+        return 0;
+    }
+
+    if (arguments.mode == "ingest")
+    {
+        // Usage: --ingest <file> [--reader=uring|pread] [--chunk=KiB] [--depth=reads in flight] [--search=0]
+        auto seconds = [](auto duration)
+        { return std::max(std::chrono::duration<double>(duration).count(), 1e-9); };
+        TraceReader reader(arguments.positional.at(0), reader_options);
+        std::string through = reader.uring() ? reader.fixed_buffers() ? "io_uring (registered buffers)" : "io_uring" : "pread";
+        auto start = std::chrono::steady_clock::now();
+        if (!arguments.option("search", 1))
         {
-            unsigned int score = (msg.login == it->second.login) + (msg.phone_number == it->second.phone_number);
-            if (score > max_score)
+            // Reading and parsing only
+            uint64_t messages = 0;
+            std::vector<TraceRecord> records;
+            while (reader.read(records))
             {
-                max_score = true;
-                best_candidate = --it.base(); // reverse_iterator to iterator
+                messages += records.size();
+                records.clear();
             }
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            log("[Ingest]: " + std::to_string(messages) + " messages, " + std::to_string(reader.bytes() >> 20) + " MiB parsed through " + through +
+                " at " + std::to_string(static_cast<uint64_t>(reader.bytes() / seconds(elapsed)) >> 20) + " MiB/s");
+            return 0;
         }
-        return best_candidate;
+
+        searcher_options.log_matches = false;
+        Container<Message> container;
+        Searcher searcher_thread(container, searcher_options);
+        uint64_t messages = ingest_trace(reader, container);
+        while (!container.empty())
+            std::this_thread::yield();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        log("[Ingest]: " + std::to_string(messages) + " messages, " + std::to_string(reader.bytes() >> 20) + " MiB through " + through +
+            " searched at " + std::to_string(static_cast<uint64_t>(messages / seconds(elapsed))) + " msg/s, " +
+            std::to_string(searcher_thread.matches()) + " matches");
+        return 0;
     }
 
-public:
-    Searcher(Container<Message> &container) : _container(container)
+    if (arguments.mode == "pipeline")
     {
-        _terminate_flag = false;
-        _thread = std::thread([this]()
-            {
-                while (!_terminate_flag)
+        // Usage: --pipeline [generators] [normalizers] [dedupers]
+        unsigned int generators_count = arguments.number(0, 1);
+        unsigned int normalizers_count = arguments.number(1, 1);
+        unsigned int dedupers_count = arguments.number(2, 1);
+        auto dedup_interval = std::chrono::milliseconds(arguments.option("dedup", 1000));
+
+        std::vector<DemoSource> sources; // one per generate worker
+        for (unsigned int i = 0; i < generators_count; ++i)
+            sources.emplace_back(std::chrono::steady_clock::now().time_since_epoch().count() + i);
+        std::vector<Deduplicator> dedupers(dedupers_count, Deduplicator(dedup_interval)); // one per dedupe worker
+        SearcherOptions match_options = searcher_options;
+        match_options.dedup_interval = std::chrono::milliseconds(0); // done by the dedupe stage
+        Searcher searcher(match_options);
+        Pipeline pipeline;
+        pipeline.source<Message>("generate", {.threads = generators_count, .batch = 1}, [&sources, &generator_options](Emitter<Message> &out)
                 {
-                    if (!_container.empty())
-                    {
-                        auto msg = _container.pop(); // blocks thread until message receiving
-                        auto time = std::chrono::steady_clock::now();
-                        auto found_it = search(msg);
-                        if (found_it != _buffer.end())
-                        {
-                            // Debug log
-                            std::string elements;
-                            for (auto it = _buffer.begin(); it != _buffer.end(); ++it)
+                    out.emit(sources[out.worker()]());
+                    std::this_thread::sleep_for(generator_options.interval);
+                    return true;
+                })
+            .then<Message>("normalize", {.threads = normalizers_count}, [](Message &&msg, Emitter<Message> &out)
+                { out.emit(normalize(msg)); })
+            .then<Message>("dedupe", {.threads = dedupers_count}, [&dedupers](Message &&msg, Emitter<Message> &out)
+                {
+                    if (!dedupers[out.worker()].is_duplicate(msg, std::chrono::steady_clock::now()))
+                        out.emit(std::move(msg));
+                },
+                // identical messages must reach the same worker
+                [](const Message &msg)
+                { return std::hash<Message::Field>{}(msg.phone_number) ^ std::hash<Message::Field>{}(msg.login); })
+            .then<Match>("match", {.threads = 1}, [&searcher](Message &&msg, Emitter<Match> &out)
+                {
+                    if (auto match = searcher.process(std::move(msg)))
+                        out.emit(std::move(*match));
+                })
+            .sink("emit", {.threads = 1}, [&log](Match &&match)
+                { log_match(log, match); });
+
+        pipeline.run();
+        std::this_thread::sleep_for(std::chrono::seconds(50));
+        pipeline.stop();
+        pipeline.report(log);
+        uint64_t dropped = 0;
+        for (auto &deduper : dedupers)
+            dropped += deduper.dropped();
+        log("[Pipeline]: Dropped duplicates: " + std::to_string(dropped));
+        return 0;
+    }
+
+    if (arguments.mode == "bench-queue")
+    {
+        // Usage: --bench-queue [max threads] [messages per producer] [capacity]
+        unsigned int max_threads = arguments.number(0, 32);
+        size_t per_thread = arguments.number(1, 200000);
+        size_t capacity = arguments.number(2, 1024);
+        for (unsigned int threads = 1; threads <= max_threads; threads *= 2)
+        {
+            Container<Message> locked;
+            MpmcContainer<Message> lock_free(capacity);
+            double locked_rate = benchmark_queue(locked, threads, per_thread);
+            double lock_free_rate = benchmark_queue(lock_free, threads, per_thread);
+            log("[Bench]: " + std::to_string(threads) + " producers x " + std::to_string(threads) + " consumers: Container " +
+                std::to_string(static_cast<uint64_t>(locked_rate)) + " msg/s, MpmcContainer " +
+                std::to_string(static_cast<uint64_t>(lock_free_rate)) + " msg/s");
+        }
+        return 0;
+    }
+
+    if (arguments.mode == "bench-matrix")
+    {
+        // Usage: --bench-matrix [--windows=ms,...] [--keys=n,...] [--match=percent,...] [--producers=n,...]
+        //        [--consumers=n,...] [--containers=mutex,mpmc,pooled] [--rate=per producer/s] [--duration=ms per cell]
+        auto numbers = [&arguments](const std::string &name, const std::string &default_value)
+        {
+            std::vector<unsigned long> result;
+            for (auto &value : arguments.list(name, default_value))
+                result.push_back(std::stoul(value));
+            return result;
+        };
+        auto duration = std::chrono::milliseconds(arguments.option("duration", 1000));
+        unsigned long rate = arguments.option("rate", 20000);
+        Clock::duration interval = rate ? std::chrono::duration_cast<Clock::duration>(std::chrono::seconds(1)) / static_cast<Clock::duration::rep>(rate) : Clock::duration(0);
+        size_t capacity = arguments.option("capacity", 65536);
+
+        log("[Bench]: window ms | keys | match % | producers | consumers | container | msg/s | p50 us | p99 us | matched %");
+        for (unsigned long window : numbers("windows", "1000,5000"))
+            for (unsigned long keys : numbers("keys", "10000"))
+                for (unsigned long match : numbers("match", "0,50"))
+                    for (unsigned long producers : numbers("producers", "1,4"))
+                        for (unsigned long consumers : numbers("consumers", "1"))
+                            for (auto &container : arguments.list("containers", "mutex,mpmc"))
                             {
-                                elements += "\n\t(" + it->second.phone_number + ", " + it->second.login + ")";
+                                BenchCell cell{std::chrono::milliseconds(window), static_cast<uint32_t>(std::clamp(keys, 1ul, 10000000ul)),
+                                               match / 100.0, static_cast<unsigned int>(producers), static_cast<unsigned int>(consumers), container};
+                                BenchResult result = container == "mpmc"     ? run_bench_cell<MpmcContainer<StampedMessage>>(cell, duration, interval, capacity)
+                                                   : container == "pooled" ? run_bench_cell<PooledContainer<StampedMessage>>(cell, duration, interval, capacity)
+                                                                           : run_bench_cell<Container<StampedMessage>>(cell, duration, interval);
+                                std::ostringstream row;
+                                row << "[Bench]: " << std::setw(9) << window << " | " << std::setw(4) << cell.keys << " | " << std::setw(7) << match
+                                    << " | " << std::setw(9) << producers << " | " << std::setw(9) << consumers << " | " << std::setw(9) << container
+                                    << " | " << std::setw(5) << static_cast<uint64_t>(result.throughput)
+                                    << " | " << std::setw(6) << std::chrono::duration_cast<std::chrono::microseconds>(result.p50).count()
+                                    << " | " << std::setw(6) << std::chrono::duration_cast<std::chrono::microseconds>(result.p99).count()
+                                    << " | " << std::fixed << std::setprecision(1) << std::setw(9) << result.matched * 100;
+                                log(row.str());
                             }
-                            if (!elements.empty())
-                                log("[Debug] [Searcher]: Internal storage:" + elements);
-                            // \Debug log
-
-                            unsigned int score = (msg.login == found_it->second.login) + (msg.phone_number == found_it->second.phone_number);
-                            log("[Searcher]: Found (with score: " + std::to_string(score) + ")\n" +
-                                "\tFrom shared storage: (" + msg.phone_number + ", " + msg.login + ")\n" +
-                                "\tFrom internal storage: (" + found_it->second.phone_number + ", " + found_it->second.login + ")\n");
-                            _buffer.erase(found_it);
-                        }
-                        else
-                        {
-                            _buffer.emplace_front(time, msg); // newer items infront
-                        }
+        return 0;
+    }
+
+    auto run_threads = [&](auto &container)
+    {
+        Generator generator_thread(container, generator_options);
+        Searcher searcher_thread(container, searcher_options);
+
+        // Read-only lookups of other messages against the live window, nothing is consumed
+        std::atomic<bool> stop_queries{false};
+        std::thread query_thread;
+        if (searcher_options.snapshot_interval.count() > 0)
+        {
+            query_thread = std::thread([&]()
+                {
+                    DemoSource source(std::chrono::steady_clock::now().time_since_epoch().count());
+                    while (!stop_queries)
+                    {
+                        Message msg = source();
+                        if (auto match = searcher_thread.query(msg))
+                            log("[Query]: (" + msg.phone_number + ", " + msg.login + ") ranks " + std::to_string(static_cast<int>(match->score)) +
+                                " against (" + match->stored.phone_number + ", " + match->stored.login + ")");
+                        std::this_thread::sleep_for(generator_options.interval);
                     }
-                }
-            });
+                });
+        }
+
+        std::this_thread::sleep_for(std::chrono::seconds(50));
+        stop_queries = true;
+        if (query_thread.joinable())
+            query_thread.join();
     };
 
-    ~Searcher()
+    if (size_t slots = arguments.option("pooled", 0))
     {
-        _terminate_flag = true;
-        _thread.join();
+        PooledContainer<Message> pooled_container(slots);
+        run_threads(pooled_container);
     }
-};
-
-int main()
-{
-    Container<Message> shared_container;
+    else if (arguments.options.count("lanes"))
+    {
+        // One Generator per lane, e.g. --lanes=8,1 for an interactive and a backfill source
+        std::vector<unsigned int> weights;
+        for (auto &weight : arguments.list("lanes", ""))
+            weights.push_back(std::stoul(weight));
+        LanePolicy policy = arguments.text("lane-policy", "strict") == "weighted" ? LanePolicy::weighted : LanePolicy::strict;
+        LaneContainer<Message> lane_container(weights, policy);
+        std::list<Generator> generators;
+        for (size_t lane = 0; lane < lane_container.lanes(); ++lane)
+        {
+            GeneratorOptions lane_options = generator_options;
+            lane_options.lane = lane;
+            generators.emplace_back(lane_container, lane_options);
+        }
+        Searcher searcher_thread(lane_container, searcher_options);
 
-    Generator generator_thread(shared_container);
-    Searcher searcher_thread(shared_container);
+        std::this_thread::sleep_for(std::chrono::seconds(50));
+    }
+    else if (size_t capacity = arguments.option("mpmc", 0))
+    {
+        MpmcContainer<Message> mpmc_container(capacity);
+        run_threads(mpmc_container);
+    }
+    else if (arguments.option("eventfd", 0))
+    {
+        // Single wait point: an inline Searcher waits on the container's eventfd together with a timer
+        Container<Message> ready_container(ContainerNotification::eventfd);
+        Generator generator_thread(ready_container, generator_options);
+        Searcher searcher(searcher_options);
+        int timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        itimerspec every_second{{1, 0}, {1, 0}};
+        timerfd_settime(timer, 0, &every_second, nullptr);
+        int poller = epoll_create1(EPOLL_CLOEXEC);
+        for (int fd : {ready_container.event_fd(), timer})
+        {
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            epoll_ctl(poller, EPOLL_CTL_ADD, fd, &event);
+        }
 
-    std::this_thread::sleep_for(std::chrono::seconds(50));
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(50);
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            epoll_event events[2];
+            int count = epoll_wait(poller, events, 2, 1000);
+            for (int i = 0; i < count; ++i)
+            {
+                if (events[i].data.fd == timer)
+                {
+                    uint64_t expirations;
+                    if (read(timer, &expirations, sizeof(expirations)) == sizeof(expirations))
+                        log("[Eventfd]: " + std::to_string(searcher.matches()) + " matches so far");
+                    continue;
+                }
+                while (auto msg = ready_container.try_pop())
+                {
+                    auto match = searcher.process(std::move(*msg));
+                    if (match && searcher_options.log_matches)
+                        log_match(log, *match);
+                }
+            }
+        }
+        close(poller);
+        close(timer);
+    }
+    else
+    {
+        run_threads(shared_container);
+    }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+// Shared by the tests. CMake builds each test as is and, with GS_TSAN_TESTS, with ThreadSanitizer:
+//   g++ -std=c++20 -pthread -g -O1 -fsanitize=thread tests/<name>.cpp -o <name>
+
+#include <cstdio>
+#include <string>
+
+inline int failures = 0;
+
+/**
+ * @brief Counts a failed condition, the first ten are described on stderr
+ */
+inline void check(bool condition, const std::string &what)
+{
+    if (!condition && failures++ < 10)
+        std::fprintf(stderr, "FAILED: %s\n", what.c_str());
+}
+
+/**
+ * @brief Exit code of a test: 1 after any failed check
+ */
+inline int finish()
+{
+    if (failures)
+        std::fprintf(stderr, "%d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,102 @@
+// Readiness of a Container in ContainerNotification::eventfd mode.
+
+#include "check.hpp"
+#include "../generator_searcher/container.hpp"
+#include "../generator_searcher/message.hpp"
+
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include <poll.h>
+#include <sys/epoll.h>
+
+static bool readable(int fd)
+{
+    pollfd descriptor{fd, POLLIN, 0};
+    return poll(&descriptor, 1, 0) == 1 && (descriptor.revents & POLLIN);
+}
+
+/**
+ * @brief The eventfd is readable exactly while elements are queued, whichever way they leave
+ */
+static void readiness()
+{
+    Container<int> plain;
+    check(plain.event_fd() == -1, "no eventfd without ContainerNotification::eventfd");
+
+    Container<int> container(ContainerNotification::eventfd);
+    int fd = container.event_fd();
+    check(fd >= 0, "eventfd created");
+    check(!readable(fd), "empty container is not readable");
+    container.push(1);
+    check(readable(fd), "readable after the first push");
+    container.push(2);
+    container.push(3);
+    check(readable(fd), "readable after more pushes");
+    check(container.try_pop() == 1, "try_pop takes the oldest element");
+    check(readable(fd), "still readable while elements remain");
+    check(container.pop() == 2, "pop takes the next element");
+    check(container.try_pop() == 3, "try_pop takes the last element");
+    check(!readable(fd), "not readable once emptied");
+    check(!container.try_pop(), "try_pop on an empty container");
+
+    container.push(4);
+    container.push(5);
+    std::vector<int> batch;
+    container.pop_batch(batch, 8);
+    check(batch.size() == 2, "pop_batch takes both elements");
+    check(!readable(fd), "not readable after pop_batch emptied it");
+}
+
+/**
+ * @brief Producers push while a consumer waits on epoll only; nothing is missed or left behind
+ */
+static void epoll_consumer(unsigned int producers, size_t per_producer)
+{
+    Container<Message> container(ContainerNotification::eventfd);
+    int poller = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = container.event_fd();
+    epoll_ctl(poller, EPOLL_CTL_ADD, container.event_fd(), &event);
+
+    std::vector<std::thread> threads;
+    for (unsigned int i = 0; i < producers; ++i)
+    {
+        threads.emplace_back([&container, i, per_producer]()
+            {
+                for (size_t n = 0; n < per_producer; ++n)
+                    container.push(Message("+7-" + std::to_string(i), std::to_string(n)));
+            });
+    }
+
+    size_t received = 0, wakeups = 0, total = producers * per_producer;
+    while (received < total)
+    {
+        epoll_event events[1];
+        if (epoll_wait(poller, events, 1, 5000) != 1)
+        {
+            check(false, "epoll_wait timed out with " + std::to_string(total - received) + " messages queued");
+            break;
+        }
+        ++wakeups;
+        while (container.try_pop())
+            ++received;
+    }
+    for (auto &thread : threads)
+        thread.join();
+    check(received == total, "received " + std::to_string(received) + " of " + std::to_string(total));
+    check(!readable(container.event_fd()), "not readable after draining");
+    close(poller);
+    std::printf("epoll consumer: %zu messages from %u producers in %zu wakeups\n", received, producers, wakeups);
+}
+
+int main()
+{
+    readiness();
+    std::printf("readiness: %s\n", failures ? "FAILED" : "ok");
+    epoll_consumer(4, 50000);
+
+    return finish();
+}
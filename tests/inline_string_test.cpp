@@ -0,0 +1,65 @@
+// InlineString on both sides of the inline limit: copies, moves and assignments between inline and heap values.
+
+#include "check.hpp"
+#include "../generator_searcher/inline_string.hpp"
+#include "../generator_searcher/message.hpp"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Every length up to past the inline limit survives copying, moving and reassignment
+ */
+template <size_t Capacity>
+static void round_trips()
+{
+    using String = InlineString<Capacity>;
+    static_assert(sizeof(String) == Capacity && String::inline_capacity == Capacity - 1);
+    std::string where = "InlineString<" + std::to_string(Capacity) + ">";
+    std::vector<std::string> values;
+    for (size_t length : {size_t(0), size_t(1), Capacity - 2, Capacity - 1, Capacity, Capacity + 1, 3 * Capacity})
+    {
+        std::string value;
+        for (size_t i = 0; i < length; ++i)
+            value += static_cast<char>('a' + i % 26);
+        values.push_back(value);
+    }
+
+    for (const std::string &value : values)
+    {
+        std::string what = where + " of " + std::to_string(value.size()) + " characters";
+        String str(value);
+        check(str.view() == value && str.size() == value.size(), what + " holds its value");
+
+        String copy(str);
+        check(copy.view() == value && str.view() == value, what + " copies");
+        String moved(std::move(copy));
+        check(moved.view() == value && copy.empty(), what + " moves");
+
+        for (const std::string &other : values)
+        {
+            String target(other);
+            target = str;
+            check(target.view() == value, what + " copy-assigned over " + std::to_string(other.size()) + " characters");
+            String source(value);
+            target = String(other);
+            target = std::move(source);
+            check(target.view() == value && source.empty(), what + " move-assigned over " + std::to_string(other.size()) + " characters");
+        }
+    }
+}
+
+int main()
+{
+    round_trips<24>();
+    round_trips<64>();
+    round_trips<255>(); // the largest Capacity: 254 characters inline, 255 is the heap tag
+
+    std::string login(100, 'x');
+    Message msg("+7-915-1234567", login);
+    Message copy = msg;
+    check(copy.login == login && copy.phone_number == "+7-915-1234567", "Message with a heap login copies");
+
+    return finish();
+}
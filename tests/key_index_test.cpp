@@ -0,0 +1,87 @@
+// KeyIndex against a std::map of lists through random inserts and erases, so probe runs grow and shrink.
+
+#include "check.hpp"
+#include "../generator_searcher/key_index.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <list>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+static void random_operations(uint64_t seed, size_t keys, size_t operations)
+{
+    std::mt19937_64 rng(seed);
+    KeyIndex<int> index;
+    std::map<std::string, std::list<int>> expected;
+    std::vector<std::pair<std::string, KeyIndex<int>::Handle>> handles;
+    std::string where = "seed " + std::to_string(seed);
+
+    for (size_t i = 0; i < operations && !failures; ++i)
+    {
+        if (handles.empty() || rng() % 5 < 3)
+        {
+            std::string key = "key_" + std::to_string(rng() % keys) + (rng() % 2 ? "" : std::string(20, 'x')); // some beyond SSO
+            int value = static_cast<int>(i);
+            handles.emplace_back(key, index.insert(key, value));
+            expected[key].push_back(value);
+        }
+        else
+        {
+            size_t victim = rng() % handles.size();
+            auto [key, handle] = handles[victim];
+            expected[key].remove(*handle);
+            if (expected[key].empty())
+                expected.erase(key);
+            index.erase(key, handle);
+            handles[victim] = handles.back();
+            handles.pop_back();
+        }
+
+        if (i % std::max<size_t>(keys, 97) == 0) // a full check costs as much as keys operations
+        {
+            for (size_t k = 0; k < keys; ++k)
+            {
+                for (std::string key : {"key_" + std::to_string(k), "key_" + std::to_string(k) + std::string(20, 'x')})
+                {
+                    auto bucket = index.find(key);
+                    auto found = expected.find(key);
+                    if (found == expected.end() ? bucket != nullptr : !bucket || *bucket != found->second)
+                    {
+                        check(false, where + ", operation " + std::to_string(i) + ": wrong bucket for " + key);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    // Batch prefetch stages agree with find() and never dereference a missing key
+    for (size_t k = 0; k < keys; ++k)
+    {
+        std::string key = "key_" + std::to_string(k);
+        size_t hash = KeyIndex<int>::hash(key);
+        index.prefetch_slot(hash);
+        index.prefetch_node(hash);
+        auto bucket = index.prefetch_bucket(key, hash);
+        check(!bucket || bucket == index.find(key, hash), where + ": prefetch_bucket disagrees with find for " + key);
+    }
+}
+
+int main()
+{
+    random_operations(1, 8, 20000);
+    random_operations(2, 200, 100000);
+    random_operations(3, 5000, 100000);
+
+    KeyIndex<int> empty;
+    check(!empty.find("key") && !empty.prefetch_bucket("key", KeyIndex<int>::hash("key")), "empty index");
+    empty.prefetch_slot(0);
+    empty.prefetch_node(0);
+    std::printf("key index: %s\n", failures ? "FAILED" : "ok");
+
+    return finish();
+}
@@ -0,0 +1,141 @@
+// Pipeline: everything emitted before stop() reaches the sink in per-source order, stage counts add
+// up, and idle or blocked workers sleep instead of spinning.
+
+#include "check.hpp"
+#include "../generator_searcher/pipeline.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sys/resource.h>
+
+struct Item
+{
+    unsigned int source = 0;
+    uint64_t sequence = 0;
+};
+
+static double cpu_seconds()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+/**
+ * @brief Sources emit numbered items as fast as they can, a transform drops every third one and a slow
+ * sink with small rings pushes back on everything upstream. After stop() each source's items must have
+ * arrived complete and in order, and every stage's in/out counts must match its neighbours'
+ */
+static void drain_on_stop(unsigned int sources, unsigned int transforms)
+{
+    Pipeline pipeline;
+    std::vector<uint64_t> emitted(sources, 0);
+    std::vector<std::vector<uint64_t>> received(sources);
+    pipeline.source<Item>("source", {.threads = sources, .batch = 4}, [&emitted](Emitter<Item> &out)
+            {
+                out.emit({out.worker(), emitted[out.worker()]++});
+                return true;
+            })
+        .then<Item>("filter", {.threads = transforms, .batch = 4, .capacity = 2}, [](Item &&item, Emitter<Item> &out)
+            {
+                if (item.sequence % 3 != 2)
+                    out.emit(std::move(item));
+            },
+            // one source always goes through the same filter worker, keeping its order
+            [](const Item &item)
+            { return item.source; })
+        .sink("sink", {.threads = 1, .batch = 4, .capacity = 2}, [&received](Item &&item)
+            {
+                received[item.source].push_back(item.sequence);
+                if (item.sequence % 64 == 0)
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+            });
+
+    pipeline.run();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    pipeline.stop();
+
+    uint64_t total = 0, kept = 0;
+    for (unsigned int source = 0; source < sources; ++source)
+    {
+        total += emitted[source];
+        uint64_t expected = 0, count = 0;
+        for (uint64_t sequence : received[source])
+        {
+            while (expected % 3 == 2)
+                ++expected;
+            if (sequence != expected)
+            {
+                check(false, "source " + std::to_string(source) + ": got " + std::to_string(sequence) + ", expected " + std::to_string(expected));
+                break;
+            }
+            ++expected;
+            ++count;
+        }
+        uint64_t should_keep = emitted[source] - emitted[source] / 3;
+        check(count == should_keep, "source " + std::to_string(source) + ": " + std::to_string(count) + " of " + std::to_string(should_keep) + " items arrived");
+        kept += should_keep;
+    }
+
+    const StageMetrics *source = pipeline.metrics("source"), *filter = pipeline.metrics("filter"), *sink = pipeline.metrics("sink");
+    check(source && filter && sink && !pipeline.metrics("none"), "stage metrics by name");
+    if (source && filter && sink)
+    {
+        check(source->items_out == total, "source out " + std::to_string(source->items_out) + " of " + std::to_string(total));
+        check(filter->items_in == total, "filter in " + std::to_string(filter->items_in) + " of " + std::to_string(total));
+        check(filter->items_out == kept, "filter out " + std::to_string(filter->items_out) + " of " + std::to_string(kept));
+        check(sink->items_in == kept, "sink in " + std::to_string(sink->items_in) + " of " + std::to_string(kept));
+        check(sink->batches_in > 0 && sink->items_in / sink->batches_in <= 4, "sink batches of at most 4");
+    }
+    std::printf("drain on stop: %u sources x %u filters, %lu emitted, %lu delivered\n", sources, transforms,
+                static_cast<unsigned long>(total), static_cast<unsigned long>(kept));
+}
+
+/**
+ * @brief With a source emitting every 20 ms, the downstream workers must sleep in between
+ */
+static void idle_workers()
+{
+    Pipeline pipeline;
+    std::atomic<uint64_t> delivered{0};
+    pipeline.source<Item>("source", {.threads = 1}, [](Emitter<Item> &out)
+            {
+                out.emit({});
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                return true;
+            })
+        .then<Item>("forward", {.threads = 4}, [](Item &&item, Emitter<Item> &out)
+            { out.emit(std::move(item)); })
+        .sink("sink", {.threads = 2}, [&delivered](Item &&)
+            { ++delivered; });
+
+    pipeline.run();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    double cpu = cpu_seconds();
+    auto start = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    double busy = (cpu_seconds() - cpu) / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    pipeline.stop();
+    check(delivered > 10, "idle pipeline delivered " + std::to_string(delivered));
+    check(busy < 0.25, "idle pipeline used " + std::to_string(static_cast<int>(busy * 100)) + "% of a core");
+    std::printf("idle workers: %lu delivered, %.0f%% of a core\n", static_cast<unsigned long>(delivered.load()), busy * 100);
+}
+
+int main()
+{
+    Message normalized = normalize(Message("+7 (915) 123-45", " User ", std::chrono::milliseconds(250)));
+    check(normalized.phone_number == "+791512345" && normalized.login == "user", "normalize strips phone separators and lowercases the login");
+    check(normalized.ttl == std::chrono::milliseconds(250), "normalize keeps the ttl");
+    check(normalize(Message("+791512345", "\tA b ")).login == "a b", "normalize keeps whitespace inside the login");
+
+    drain_on_stop(1, 1);
+    drain_on_stop(3, 2);
+    idle_workers();
+    return finish();
+}
@@ -0,0 +1,415 @@
+// Randomized differential test of the Searcher against a naive reference model.
+
+#include "check.hpp"
+#include "../generator_searcher/container.hpp"
+#include "../generator_searcher/generator.hpp"
+#include "../generator_searcher/mpmc_container.hpp"
+#include "../generator_searcher/searcher.hpp"
+
+#include <cstdio>
+#include <random>
+#include <tuple>
+
+/**
+ * @brief The original Searcher: a list scanned from the oldest element, with the max_score fix
+ * (the best score is tracked instead of being reset to 1). Knows nothing of the indexes
+ */
+class ReferenceSearcher
+{
+    struct Stored
+    {
+        Clock::time_point expiry;
+        Message message;
+    };
+
+    std::list<Stored> _buffer; // newer items in front
+    const SearcherOptions _options;
+
+    static std::string digits(std::string_view phone_number)
+    {
+        std::string result;
+        for (char c : phone_number)
+        {
+            if (c >= '0' && c <= '9')
+                result += c;
+        }
+        return result;
+    }
+
+    static unsigned int levenshtein(std::string_view a, std::string_view b)
+    {
+        std::vector<std::vector<unsigned int>> d(a.size() + 1, std::vector<unsigned int>(b.size() + 1));
+        for (size_t i = 0; i <= a.size(); ++i)
+            d[i][0] = i;
+        for (size_t j = 0; j <= b.size(); ++j)
+            d[0][j] = j;
+        for (size_t i = 1; i <= a.size(); ++i)
+        {
+            for (size_t j = 1; j <= b.size(); ++j)
+                d[i][j] = std::min({d[i - 1][j] + 1, d[i][j - 1] + 1, d[i - 1][j - 1] + (a[i - 1] != b[j - 1])});
+        }
+        return d[a.size()][b.size()];
+    }
+
+    double score(const Message &msg, const Message &other) const
+    {
+        double result = 0;
+        std::string a = digits(msg.phone_number), b = digits(other.phone_number);
+        size_t suffix = _options.phone_suffix_digits, prefix = _options.phone_prefix_digits;
+        if (msg.phone_number == other.phone_number)
+            result += 1;
+        else if ((suffix && a.size() >= suffix && b.size() >= suffix && a.substr(a.size() - suffix) == b.substr(b.size() - suffix)) ||
+                 (prefix && a.size() >= prefix && b.size() >= prefix && a.substr(0, prefix) == b.substr(0, prefix)))
+            result += _options.phone_partial_weight;
+        if (msg.login == other.login)
+            result += 1;
+        else if (_options.fuzzy_login_distance && levenshtein(msg.login.view(), other.login.view()) <= _options.fuzzy_login_distance)
+            result += _options.fuzzy_login_weight;
+        return result;
+    }
+
+public:
+    explicit ReferenceSearcher(const SearcherOptions &options) : _options(options) {}
+
+    std::optional<Match> process(const Message &msg, Clock::time_point time)
+    {
+        _buffer.remove_if([time](const Stored &stored)
+                          { return time >= stored.expiry; });
+
+        auto best_candidate = _buffer.end();
+        double max_score = 0;
+        for (auto it = _buffer.rbegin(); it != _buffer.rend(); ++it)
+        {
+            double score = this->score(msg, it->message);
+            if (score > max_score)
+            {
+                max_score = score;
+                best_candidate = std::prev(it.base());
+            }
+        }
+        if (best_candidate != _buffer.end())
+        {
+            Match match{msg, best_candidate->message, max_score};
+            _buffer.erase(best_candidate);
+            return match;
+        }
+
+        auto ttl = msg.ttl.count() > 0 ? msg.ttl : _options.window;
+        auto granularity = std::max(_options.expiry_granularity, Clock::duration(1));
+        auto deadline = (time + ttl).time_since_epoch();
+        Clock::time_point expiry((deadline + granularity - Clock::duration(1)) / granularity * granularity);
+        _buffer.push_front({expiry, msg});
+        return std::nullopt;
+    }
+};
+
+static std::string describe(const std::optional<Match> &match)
+{
+    if (!match)
+        return "no match";
+    return std::to_string(match->score) + " (" + match->stored.phone_number + ", " + match->stored.login + ")";
+}
+
+static bool same_decision(const std::optional<Match> &a, const std::optional<Match> &b)
+{
+    if (a.has_value() != b.has_value())
+        return false;
+    return !a || (a->score == b->score && a->stored.phone_number == b->stored.phone_number && a->stored.login == b->stored.login);
+}
+
+/**
+ * @brief Random messages over a small key space, so that exact, partial and fuzzy candidates are frequent
+ */
+class MessageSource
+{
+    std::mt19937_64 _rng;
+    const uint32_t _keys;
+    const double _ttl_share;
+
+public:
+    MessageSource(uint64_t seed, uint32_t keys, double ttl_share) : _rng(seed), _keys(keys), _ttl_share(ttl_share) {}
+
+    Message next()
+    {
+        static const char *country_codes[] = {"+7", "+1", "+44"};
+        std::string phone = std::string(country_codes[_rng() % 3]) + "-" + std::to_string(1000000 + _rng() % _keys);
+        std::string login = "user" + std::to_string(_rng() % _keys);
+        if (_rng() % 4 == 0)
+            login[_rng() % login.size()] = 'a' + _rng() % 3; // near miss for fuzzy matching
+        auto ttl = std::uniform_real_distribution<double>(0, 1)(_rng) < _ttl_share ? std::chrono::milliseconds(1 + _rng() % 300) : std::chrono::milliseconds(0);
+        return Message(phone, login, ttl);
+    }
+
+    std::chrono::milliseconds step()
+    {
+        return std::chrono::milliseconds(_rng() % 20);
+    }
+
+    uint64_t operator()()
+    {
+        return _rng();
+    }
+};
+
+static SearcherOptions random_options(std::mt19937_64 &rng, SimulatedClock &clock)
+{
+    SearcherOptions options;
+    options.window = std::chrono::milliseconds(std::array{50, 200, 1000}[rng() % 3]);
+    options.expiry_granularity = std::chrono::milliseconds(std::array{1, 7, 50}[rng() % 3]);
+    options.fuzzy_login_distance = rng() % 3;
+    options.phone_suffix_digits = rng() % 2 ? 4 : 0;
+    options.phone_prefix_digits = rng() % 2 ? 3 : 0;
+    if (rng() % 3 == 0)
+    {
+        // Deletion-only candidates all score fuzzy_login_weight, so stopping at the oldest one decides the same
+        options.fanout_cap = 1 + rng() % 3;
+        options.fanout_policy = rng() % 2 ? FanoutPolicy::first_candidate : FanoutPolicy::spill;
+    }
+    options.log_matches = false;
+    options.clock = &clock;
+    return options;
+}
+
+/**
+ * @brief Single-threaded traces through process() and process_batch()
+ */
+static void differential_traces(unsigned int traces, unsigned int messages)
+{
+    for (unsigned int trace = 0; trace < traces; ++trace)
+    {
+        std::mt19937_64 rng(trace);
+        SimulatedClock clock;
+        SearcherOptions options = random_options(rng, clock);
+        MessageSource source(trace, std::array{5u, 30u, 200u}[rng() % 3], trace % 2 ? 0.3 : 0.0);
+        bool batched = trace % 3 == 0;
+        Searcher searcher(options);
+        ReferenceSearcher reference(options);
+
+        std::string where = "trace " + std::to_string(trace) + (batched ? " (batched)" : "");
+        for (unsigned int i = 0; i < messages && !failures;)
+        {
+            // One batch shares the arrival time; process() calls advance the clock in between
+            size_t batch_size = batched ? 1 + source() % 16 : 1;
+            clock.advance(source.step());
+            std::vector<Message> batch;
+            for (size_t j = 0; j < batch_size; ++j)
+                batch.push_back(source.next());
+
+            std::vector<std::optional<Match>> expected;
+            for (auto &msg : batch)
+                expected.push_back(reference.process(msg, clock.now()));
+            std::vector<std::optional<Match>> actual;
+            if (batched)
+            {
+                std::vector<Match> matches;
+                if (trace % 2)
+                    matches = searcher.process_batch(batch);
+                else
+                    searcher.process_batch(batch, [&matches](const Message &incoming, const Message &stored, double score)
+                                           { matches.push_back({incoming, stored, score}); });
+                auto match = matches.begin();
+                for (auto &decision : expected)
+                    actual.push_back(decision && match != matches.end() ? std::optional<Match>(*match++) : std::nullopt);
+                check(match == matches.end(), where + ": more batch matches than expected");
+            }
+            else
+            {
+                actual.push_back(searcher.process(Message(batch[0])));
+            }
+            for (size_t j = 0; j < batch.size(); ++j, ++i)
+                check(same_decision(expected[j], actual[j]), where + ", message " + std::to_string(i) + ": expected " + describe(expected[j]) + ", got " + describe(actual[j]));
+        }
+    }
+}
+
+/**
+ * @brief Several Generator threads feed a container; one consumer advances the clock and runs the
+ * Searcher while other threads query it. The consumed sequence is then replayed through the reference
+ */
+template <class Queue, class... Args>
+static void concurrent_producers(const std::string &name, unsigned int producers, size_t messages, Args &&...queue_args)
+{
+    Queue queue(std::forward<Args>(queue_args)...);
+    SimulatedClock clock, generator_clock;
+    std::mt19937_64 rng(producers);
+    SearcherOptions options = random_options(rng, clock);
+    options.snapshot_interval = std::chrono::milliseconds(10);
+    options.hot_key_threshold = 20;
+    Searcher searcher(options);
+
+    struct Decision
+    {
+        Message message;
+        Clock::time_point time;
+        std::optional<Match> match;
+    };
+    std::vector<Decision> decisions;
+    decisions.reserve(messages);
+    std::atomic<bool> consumed{false};
+    std::atomic<uint64_t> queries{0};
+    {
+        std::list<Generator> generators;
+        for (unsigned int i = 0; i < producers; ++i)
+        {
+            GeneratorOptions generator_options;
+            generator_options.interval = Clock::duration(0);
+            generator_options.log_messages = false;
+            generator_options.clock = &generator_clock;
+            generator_options.source = [source = std::make_shared<MessageSource>(100 + i, 30, 0.2)]()
+            { return source->next(); };
+            generators.emplace_back(queue, generator_options);
+        }
+
+        std::thread reader([&]()
+            {
+                MessageSource source(7, 30, 0);
+                while (!consumed)
+                {
+                    searcher.query(source.next());
+                    searcher.hot_phones();
+                    searcher.matches();
+                    ++queries;
+                }
+            });
+
+        std::mt19937_64 steps(1);
+        while (decisions.size() < messages)
+        {
+            Message msg = queue.pop();
+            clock.advance(std::chrono::milliseconds(steps() % 5));
+            auto match = searcher.process(Message(msg));
+            decisions.push_back({std::move(msg), clock.now(), std::move(match)});
+        }
+        consumed = true;
+        reader.join();
+
+        // Producers may be blocked on a bounded queue, keep draining until they have stopped
+        std::atomic<bool> draining{true};
+        std::thread drain([&]()
+            {
+                while (draining)
+                {
+                    if (!queue.empty())
+                        queue.pop();
+                }
+            });
+        generators.clear();
+        draining = false;
+        drain.join();
+    }
+
+    ReferenceSearcher reference(options);
+    for (size_t i = 0; i < decisions.size() && !failures; ++i)
+    {
+        auto expected = reference.process(decisions[i].message, decisions[i].time);
+        check(same_decision(expected, decisions[i].match), name + ", message " + std::to_string(i) + ": expected " + describe(expected) + ", got " + describe(decisions[i].match));
+    }
+    std::printf("%s: %zu messages from %u producers, %lu matches, %lu concurrent queries\n", name.c_str(), decisions.size(), producers,
+                static_cast<unsigned long>(searcher.matches()), static_cast<unsigned long>(queries.load()));
+}
+
+/**
+ * @brief A threaded Searcher hands every match to both sinks, the batched one in groups of at most
+ * match_batch. The clock stands still, so an inline Searcher fed the same messages finds the same matches
+ */
+static void threaded_sinks(size_t messages)
+{
+    Container<Message> queue;
+    SimulatedClock clock;
+    SearcherOptions options;
+    options.log_matches = false;
+    options.clock = &clock;
+    options.match_batch = 16;
+    uint64_t single = 0, batched = 0;
+    size_t largest_batch = 0;
+    options.on_match = [&single](const Message &incoming, const Message &stored, double score)
+    {
+        check(score > 0 && (incoming.phone_number == stored.phone_number || incoming.login == stored.login), "on_match: not a match");
+        ++single;
+    };
+    options.on_matches = [&](std::span<const Match> matches)
+    {
+        check(!matches.empty(), "on_matches: empty batch");
+        largest_batch = std::max(largest_batch, matches.size());
+        batched += matches.size();
+    };
+
+    MessageSource source(3, 30, 0);
+    std::vector<Message> sent;
+    {
+        Searcher searcher(queue, options);
+        for (size_t i = 0; i < messages; ++i)
+        {
+            sent.push_back(source.next());
+            queue.push(Message(sent.back()));
+        }
+        while (!queue.empty())
+            std::this_thread::yield();
+    } // joins the matching thread, which finishes the message it popped last
+
+    SearcherOptions inline_options = options;
+    inline_options.on_match = nullptr;
+    inline_options.on_matches = nullptr;
+    Searcher inline_searcher(inline_options);
+    for (auto &msg : sent)
+        inline_searcher.process(std::move(msg));
+    uint64_t expected = inline_searcher.matches();
+    check(single == expected && batched == expected, "sinks: " + std::to_string(single) + " single and " + std::to_string(batched) +
+                                                         " batched deliveries of " + std::to_string(expected) + " matches");
+    check(largest_batch <= options.match_batch, "sinks: batch of " + std::to_string(largest_batch));
+    std::printf("threaded sinks: %lu matches, largest batch %zu\n", static_cast<unsigned long>(expected), largest_batch);
+}
+
+/**
+ * @brief "xab", "abx" and "axb" are 2 edits apart but share the deletion variant "ab", so with a cap of 2
+ * a lookup of "ab" goes through a capped bucket. No policy may drop a stored message
+ */
+static void fanout_policies()
+{
+    for (auto [policy, name, expected] : {std::tuple{FanoutPolicy::keep_newest, "keep_newest", "+7-222"},
+                                          std::tuple{FanoutPolicy::first_candidate, "first_candidate", "+7-111"},
+                                          std::tuple{FanoutPolicy::spill, "spill", "+7-111"}})
+    {
+        SimulatedClock clock;
+        SearcherOptions options;
+        options.fuzzy_login_distance = 1;
+        options.fanout_cap = 2;
+        options.fanout_policy = policy;
+        options.log_matches = false;
+        options.clock = &clock;
+        std::string where = std::string("fanout ") + name;
+
+        Searcher searcher(options);
+        for (auto [phone, login] : {std::pair{"+7-111", "xab"}, std::pair{"+7-222", "abx"}, std::pair{"+7-333", "axb"}})
+            check(!searcher.process(Message(phone, login)), where + ": " + login + " matched");
+        auto repeat = searcher.process(Message("+7-111", "xab"));
+        check(repeat && repeat->score == 2 && repeat->stored.phone_number == "+7-111", where + ": exact repeat got " + describe(repeat));
+
+        Searcher capped(options);
+        for (auto [phone, login] : {std::pair{"+7-111", "xab"}, std::pair{"+7-222", "abx"}, std::pair{"+7-333", "axb"}})
+            capped.process(Message(phone, login));
+        auto fuzzy = capped.process(Message("+7-999", "ab"));
+        check(fuzzy && fuzzy->stored.phone_number == expected, where + ": fuzzy lookup got " + describe(fuzzy));
+        check(capped.fanout_cap_hits() > 0, where + ": cap not hit");
+        for (auto [phone, login] : {std::pair{"+7-111", "xab"}, std::pair{"+7-222", "abx"}, std::pair{"+7-333", "axb"}})
+        {
+            if (fuzzy && fuzzy->stored.phone_number == phone)
+                continue;
+            auto stored = capped.process(Message(phone, login));
+            check(stored && stored->score == 2, where + ": " + login + " was not kept, got " + describe(stored));
+        }
+    }
+}
+
+int main()
+{
+    differential_traces(40, 2000);
+    std::printf("differential traces: %s\n", failures ? "FAILED" : "ok");
+    fanout_policies();
+
+    concurrent_producers<Container<Message>>("Container", 4, 20000);
+    concurrent_producers<MpmcContainer<Message>>("MpmcContainer", 4, 20000, 256);
+    threaded_sinks(20000);
+
+    return finish();
+}
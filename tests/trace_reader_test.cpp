@@ -0,0 +1,207 @@
+// TraceReader against std::getline() parsing, over chunk sizes that split lines anywhere.
+
+#include "check.hpp"
+#include "../generator_searcher/container.hpp"
+#include "../generator_searcher/trace_reader.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static std::string describe(const TraceRecord &record)
+{
+    return std::to_string(record.time.count()) + " " + record.message.phone_number + " " + record.message.login + " " +
+           std::to_string(record.message.ttl.count());
+}
+
+/**
+ * @brief A trace with the awkward parts: ttls, tabs, CRLF, blank and malformed lines, no final newline
+ */
+static std::string make_trace(size_t lines)
+{
+    std::mt19937_64 rng(lines);
+    std::ostringstream trace;
+    for (size_t i = 0; i < lines; ++i)
+    {
+        switch (rng() % 16)
+        {
+        case 0:
+            trace << "\n";
+            break;
+        case 1:
+            trace << "garbage line\n";
+            break;
+        case 2:
+            trace << i << "\t+7-" << rng() % 1000 << "\tlogin_" << rng() % 100 << "\t" << rng() % 500 << "\r\n";
+            break;
+        default:
+            trace << i << " +7-915-" << rng() % 10000000 << " login_" << std::string(rng() % 12, 'x') << rng() % 100;
+            if (rng() % 3 == 0)
+                trace << " " << rng() % 500;
+            trace << "\n";
+        }
+    }
+    trace << lines << " +7-915-0000000 last_line_without_newline";
+    return trace.str();
+}
+
+/**
+ * @brief Whether this kernel runs IORING_OP_READ, in which case TraceReader must not fall back to pread()
+ */
+static bool uring_reads_supported()
+{
+    io_uring_params params{};
+    int ring = static_cast<int>(syscall(__NR_io_uring_setup, 1, &params));
+    if (ring < 0)
+        return false;
+    std::vector<char> buffer(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op));
+    auto *probe = reinterpret_cast<io_uring_probe *>(buffer.data());
+    bool supported = syscall(__NR_io_uring_register, ring, IORING_REGISTER_PROBE, probe, 256) == 0 &&
+                     IORING_OP_READ < probe->ops_len && (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED);
+    close(ring);
+    return supported;
+}
+
+static std::vector<TraceRecord> parse_lines(const std::string &text)
+{
+    std::vector<TraceRecord> records;
+    std::istringstream trace(text);
+    std::string line;
+    while (std::getline(trace, line))
+    {
+        if (auto record = parse_trace_record(line))
+            records.push_back(std::move(*record));
+    }
+    return records;
+}
+
+static void chunked_reads(const std::string &path, const std::vector<TraceRecord> &expected)
+{
+    bool uring_expected = uring_reads_supported();
+    for (size_t chunk_size : {4096, 4097, 10000, 65536, 1 << 20})
+    {
+        for (bool use_uring : {true, false})
+        {
+            TraceReaderOptions options;
+            options.chunk_size = chunk_size;
+            options.queue_depth = 3;
+            options.use_uring = use_uring;
+            TraceReader reader(path, options);
+            std::vector<TraceRecord> records;
+            while (reader.read(records))
+                ;
+            std::string where = "chunk " + std::to_string(chunk_size) + (reader.uring() ? " io_uring" : " pread");
+            if (use_uring && uring_expected)
+                check(reader.uring(), where + ": fell back to pread() although the kernel supports io_uring reads");
+            check(use_uring || !reader.uring(), where + ": io_uring used with use_uring false");
+            check(records.size() == expected.size(), where + ": " + std::to_string(records.size()) + " records, expected " + std::to_string(expected.size()));
+            for (size_t i = 0; i < std::min(records.size(), expected.size()); ++i)
+            {
+                if (describe(records[i]) != describe(expected[i]))
+                {
+                    check(false, where + ", record " + std::to_string(i) + ": " + describe(records[i]) + ", expected " + describe(expected[i]));
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief ingest_trace() blocks while the container is over max_queued and wakes as a consumer drains it
+ */
+static void paced_ingest(const std::string &path, const std::vector<TraceRecord> &expected)
+{
+    const size_t max_queued = 1000;
+    Container<Message> container;
+    std::atomic<size_t> most_queued{0};
+    std::vector<Message> received;
+    std::thread consumer([&]()
+        {
+            std::vector<Message> batch;
+            while (received.size() < expected.size())
+            {
+                most_queued = std::max(most_queued.load(), container.size());
+                container.pop_batch(batch, 64);
+                for (auto &msg : batch)
+                    received.push_back(std::move(msg));
+                batch.clear();
+            }
+        });
+    TraceReaderOptions options;
+    options.chunk_size = 16384;
+    TraceReader reader(path, options);
+    uint64_t messages = ingest_trace(reader, container, max_queued);
+    consumer.join();
+    check(messages == expected.size() && received.size() == expected.size(), "paced ingest delivered " + std::to_string(received.size()) + " messages");
+    for (size_t i = 0; i < std::min(received.size(), expected.size()); ++i)
+    {
+        if (received[i].login != expected[i].message.login)
+        {
+            check(false, "paced ingest order at " + std::to_string(i));
+            break;
+        }
+    }
+    // Each push_batch() adds one chunk's records, a few hundred at 16 KiB
+    check(most_queued < max_queued + 1000, "paced ingest queued up to " + std::to_string(most_queued.load()));
+    std::printf("paced ingest: at most %zu queued\n", most_queued.load());
+}
+
+int main()
+{
+    std::string text = make_trace(50000);
+    // A file of its own: the plain and the ThreadSanitizer build may run at once in the same directory
+    char name[] = "trace_reader_test.XXXXXX";
+    int fd = mkstemp(name);
+    check(fd >= 0, "mkstemp");
+    if (fd < 0)
+        return finish();
+    close(fd);
+    std::string path = name;
+    std::ofstream(path, std::ios::binary) << text;
+    std::vector<TraceRecord> expected = parse_lines(text);
+    check(expected.size() > 40000, "trace has records");
+    check(describe(expected.back()) == "50000 +7-915-0000000 last_line_without_newline 0", "last line parsed");
+
+    chunked_reads(path, expected);
+    std::printf("chunked reads: %s\n", failures ? "FAILED" : "ok");
+
+    Container<Message> container;
+    TraceReader reader(path);
+    uint64_t messages = ingest_trace(reader, container);
+    check(messages == expected.size() && container.size() == expected.size(), "ingest_trace pushed " + std::to_string(messages) + " messages");
+    for (size_t i = 0; i < expected.size() && !container.empty(); ++i)
+    {
+        Message msg = container.pop();
+        if (msg.phone_number != expected[i].message.phone_number || msg.login != expected[i].message.login)
+        {
+            check(false, "ingest_trace order at " + std::to_string(i));
+            break;
+        }
+    }
+    std::printf("ingest: %lu messages\n", static_cast<unsigned long>(messages));
+
+    paced_ingest(path, expected);
+
+    {
+        // Destroyed with reads in flight
+        TraceReaderOptions options;
+        options.chunk_size = 4096;
+        TraceReader early(path, options);
+        std::vector<TraceRecord> records;
+        early.read(records);
+        check(!records.empty(), "first chunk read");
+    }
+
+    std::remove(path.c_str());
+    return finish();
+}